@@ -4,9 +4,7 @@
 
 #include <Cutter.h>
 
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
+#include <AnnotatedCode.h>
 
 R2GhidraDecompiler::R2GhidraDecompiler(QObject *parent)
 	: Decompiler("r2ghidra", "Ghidra", parent)
@@ -19,45 +17,39 @@ void R2GhidraDecompiler::decompileAt(RVA addr)
 	if(task)
 		return;
 
-	AnnotatedCode code = {};
-
-	task = new R2Task ("pdgj @ " + QString::number(addr));
+	task = new R2Task ("pdgb @ " + QString::number(addr));
 
 	connect(task, &R2Task::finished, this, [this]() {
 		AnnotatedCode code = {};
-		QString s;
 
-		QJsonObject json = task->getResultJson().object();
+		QString result = task->getResult();
 		delete task;
 		task = nullptr;
-		if(json.isEmpty())
+
+		RAnnotatedCode *decoded = r_annotated_code_deserialize_base64(result.toUtf8().constData());
+		if(!decoded)
 		{
-			code.code = tr("Failed to parse JSON from r2ghidra");
+			// errors are printed as comments instead of a dump
+			result = result.trimmed();
+			code.code = result.isEmpty() ? tr("Failed to decode the output of r2ghidra") : result + "\n";
 			emit finished(code);
 			return;
 		}
 
-		auto root = json;
-		code.code = root["code"].toString();
-
-		for(QJsonValueRef annotationValue : root["annotations"].toArray())
+		code.code = QString::fromUtf8(decoded->code);
+		for(size_t i = 0; i < decoded->annotations.len; i++)
 		{
-			QJsonObject annotationObject = annotationValue.toObject();
-			CodeAnnotation annotation = {};
-			annotation.start = (size_t)annotationObject["start"].toVariant().toULongLong();
-			annotation.end = (size_t)annotationObject["end"].toVariant().toULongLong();
-			if(annotationObject["type"].toString() == "offset")
-			{
-				annotation.type = CodeAnnotation::Type::Offset;
-				annotation.offset.offset = annotationObject["offset"].toVariant().toULongLong();
-			}
-			else
+			auto annotation = reinterpret_cast<RCodeAnnotation *>(r_vector_index_ptr(&decoded->annotations, i));
+			if(annotation->type != R_CODE_ANNOTATION_TYPE_OFFSET)
 				continue;
-			code.annotations.push_back(annotation);
+			CodeAnnotation codeAnnotation = {};
+			codeAnnotation.start = annotation->start;
+			codeAnnotation.end = annotation->end;
+			codeAnnotation.type = CodeAnnotation::Type::Offset;
+			codeAnnotation.offset.offset = annotation->offset.offset;
+			code.annotations.push_back(codeAnnotation);
 		}
-
-		for(QJsonValueRef error : json["errors"].toArray())
-			code.code += "// " + error.toString() + "\n";
+		r_annotated_code_free(decoded);
 
 		emit finished(code);
 	});
@@ -14,55 +14,160 @@ R_API RAnnotatedCode *r_annotated_code_new(char *code) {
 	return r;
 }
 
-R_API void r_annotated_code_free(RAnnotatedCode *code) {
-	if (!code) {
+/**
+ * Annotations sorted by start, with the maximum end of all annotations up to each position,
+ * so everything ending before some offset can be skipped at once.
+ */
+struct r_annotated_code_index_t {
+	size_t count;
+	size_t *order; // indices into annotations, sorted by start, then by index
+	size_t *max_end; // max_end[i] = maximum end of annotations order[0..i]
+};
+
+static void index_free(RAnnotatedCodeIndex *index) {
+	if (!index) {
 		return;
 	}
-	r_vector_clear (&code->annotations);
-	r_free (code->code);
-	r_free (code);
+	free (index->order);
+	free (index->max_end);
+	free (index);
 }
 
-R_API void r_annotated_code_add_annotation(RAnnotatedCode *code, RCodeAnnotation *annotation) {
-	r_vector_push (&code->annotations, annotation);
+typedef struct {
+	size_t start;
+	size_t idx;
+} IndexSortItem;
+
+static int cmp_index_sort_item(const void *a, const void *b) {
+	const IndexSortItem *ia = a;
+	const IndexSortItem *ib = b;
+	if (ia->start != ib->start) {
+		return ia->start < ib->start ? -1 : 1;
+	}
+	return ia->idx < ib->idx ? -1 : (ia->idx > ib->idx ? 1 : 0);
 }
 
-R_API RPVector *r_annotated_code_annotations_in(RAnnotatedCode *code, size_t offset) {
-	RPVector *r = r_pvector_new (NULL);
-	if (!r) {
+static RAnnotatedCodeIndex *get_index(RAnnotatedCode *code) {
+	if (code->index) {
+		return code->index;
+	}
+	RAnnotatedCodeIndex *index = R_NEW0 (RAnnotatedCodeIndex);
+	if (!index) {
 		return NULL;
 	}
-	RCodeAnnotation *annotation;
-	r_vector_foreach (&code->annotations, annotation) {
-		if (offset >= annotation->start && offset < annotation->end) {
-			r_pvector_push (r, annotation);
+	index->count = code->annotations.len;
+	index->order = malloc (sizeof (size_t) * (index->count ? index->count : 1));
+	index->max_end = malloc (sizeof (size_t) * (index->count ? index->count : 1));
+	if (!index->order || !index->max_end) {
+		index_free (index);
+		return NULL;
+	}
+	IndexSortItem *items = malloc (sizeof (IndexSortItem) * (index->count ? index->count : 1));
+	if (!items) {
+		index_free (index);
+		return NULL;
+	}
+	size_t i;
+	for (i = 0; i < index->count; i++) {
+		const RCodeAnnotation *annotation = r_vector_index_ptr (&code->annotations, i);
+		items[i].start = annotation->start;
+		items[i].idx = i;
+	}
+	// ties are broken by index, so the unstable qsort still gives a deterministic order
+	qsort (items, index->count, sizeof (IndexSortItem), cmp_index_sort_item);
+	for (i = 0; i < index->count; i++) {
+		index->order[i] = items[i].idx;
+	}
+	free (items);
+	size_t max_end = 0;
+	for (i = 0; i < index->count; i++) {
+		const RCodeAnnotation *annotation = r_vector_index_ptr (&code->annotations, index->order[i]);
+		if (annotation->end > max_end) {
+			max_end = annotation->end;
 		}
+		index->max_end[i] = max_end;
 	}
-	return r;
+	code->index = index;
+	return index;
 }
 
-R_API RPVector *r_annotated_code_annotations_range(RAnnotatedCode *code, size_t start, size_t end) {
+/**
+ * @return number of annotations in index with start <= offset
+ */
+static size_t index_count_starting_until(RAnnotatedCode *code, RAnnotatedCodeIndex *index, size_t offset) {
+	size_t lo = 0;
+	size_t hi = index->count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		const RCodeAnnotation *annotation = r_vector_index_ptr (&code->annotations, index->order[mid]);
+		if (annotation->start <= offset) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+static int cmp_ptr(const void *a, const void *b) {
+	const void *pa = *(void * const *)a;
+	const void *pb = *(void * const *)b;
+	return pa < pb ? -1 : (pa > pb ? 1 : 0);
+}
+
+/**
+ * Collect all annotations with start <= last and end > first, in the order they were added
+ */
+static RPVector *annotations_overlapping(RAnnotatedCode *code, size_t first, size_t last) {
 	RPVector *r = r_pvector_new (NULL);
 	if (!r) {
 		return NULL;
 	}
-	RCodeAnnotation *annotation;
-	r_vector_foreach (&code->annotations, annotation) {
-		if (start >= annotation->end || end < annotation->start) {
-			continue;
+	RAnnotatedCodeIndex *index = get_index (code);
+	if (!index) {
+		r_pvector_free (r);
+		return NULL;
+	}
+	size_t i = index_count_starting_until (code, index, last);
+	while (i > 0 && index->max_end[i - 1] > first) {
+		i--;
+		RCodeAnnotation *annotation = r_vector_index_ptr (&code->annotations, index->order[i]);
+		if (annotation->end > first) {
+			r_pvector_push (r, annotation);
 		}
-		r_pvector_push (r, annotation);
+	}
+	// annotations are stored contiguously, so their addresses give the order they were added in
+	if (r_pvector_len (r) > 1) {
+		qsort (r->v.a, r_pvector_len (r), sizeof (void *), cmp_ptr);
 	}
 	return r;
 }
 
-R_API void r_annotated_code_print_json(RAnnotatedCode *code) {
-	PJ *pj = pj_new ();
-	if (!pj) {
+R_API void r_annotated_code_free(RAnnotatedCode *code) {
+	if (!code) {
 		return;
 	}
+	index_free (code->index);
+	r_vector_clear (&code->annotations);
+	r_free (code->code);
+	r_free (code);
+}
 
-	pj_o (pj);
+R_API void r_annotated_code_add_annotation(RAnnotatedCode *code, RCodeAnnotation *annotation) {
+	index_free (code->index);
+	code->index = NULL;
+	r_vector_push (&code->annotations, annotation);
+}
+
+R_API RPVector *r_annotated_code_annotations_in(RAnnotatedCode *code, size_t offset) {
+	return annotations_overlapping (code, offset, offset);
+}
+
+R_API RPVector *r_annotated_code_annotations_range(RAnnotatedCode *code, size_t start, size_t end) {
+	return annotations_overlapping (code, start, end);
+}
+
+R_API void r_annotated_code_json(RAnnotatedCode *code, PJ *pj) {
 	pj_ks (pj, "code", code->code);
 
 	pj_k (pj, "annotations");
@@ -113,7 +218,16 @@ R_API void r_annotated_code_print_json(RAnnotatedCode *code) {
 		pj_end (pj);
 	}
 	pj_end (pj);
+}
 
+R_API void r_annotated_code_print_json(RAnnotatedCode *code) {
+	PJ *pj = pj_new ();
+	if (!pj) {
+		return;
+	}
+
+	pj_o (pj);
+	r_annotated_code_json (code, pj);
 	pj_end (pj);
 	r_cons_printf ("%s\n", pj_string (pj));
 	pj_free (pj);
@@ -121,12 +235,23 @@ R_API void r_annotated_code_print_json(RAnnotatedCode *code) {
 
 
 #define PALETTE(x) (cons && cons->context->pal.x)? cons->context->pal.x 
-#define PRINT_COLOR(x) do { if (cons->context->color_mode) { r_cons_printf("%s", (x)); } } while (0)
+#define APPEND_COLOR(x) do { if (color) { r_strbuf_append (sb, (x)); } } while (0)
+
+typedef struct {
+	RStrBuf *sb;
+	const char *code;
+	bool color;
+	RVector *line_offsets;
+	size_t line_idx;
+	const char *offset_fmt;
+	const char *offset_color;
+	const char *offset_none; // printed instead of the offset for lines without one
+} PrintCtx;
 
 /**
  * @param width maximum nibbles per address
  */
-static void print_offset_in_binary_line_bar(RAnnotatedCode *code, ut64 offset, size_t width) {
+static void print_ctx_init_offsets(PrintCtx *ctx, size_t width) {
 	static const char *fmt[9] = {
 		"0x%08"PFMT64x,
 		"0x%09"PFMT64x,
@@ -138,6 +263,7 @@ static void print_offset_in_binary_line_bar(RAnnotatedCode *code, ut64 offset, s
 		"0x%015"PFMT64x,
 		"0x%016"PFMT64x
 	};
+	static const char *none = "                      "; // 4 + 10 + (16 - 8) spaces
 	if (width < 8) {
 		width = 8;
 	}
@@ -145,35 +271,80 @@ static void print_offset_in_binary_line_bar(RAnnotatedCode *code, ut64 offset, s
 		width = 16;
 	}
 	width -= 8;
+	ctx->offset_fmt = fmt[width];
+	ctx->offset_none = none + (16 - 8 - width);
+	RCons *cons = r_cons_singleton ();
+	ctx->offset_color = PALETTE(offset): Color_GREEN;
+}
 
-	RCons *cons = r_cons_singleton();
-	r_cons_printf("    ");
+static void print_offset_in_binary_line_bar(PrintCtx *ctx, ut64 offset, const char *color_after) {
+	RStrBuf *sb = ctx->sb;
+	bool color = ctx->color;
+	if (color_after) {
+		APPEND_COLOR (Color_RESET);
+	}
 	if (offset == UT64_MAX) {
-		r_cons_print ("          ");
-		while (width > 0) {
-			r_cons_print (" ");
-			width--;
-		}
+		r_strbuf_append (sb, ctx->offset_none);
 	} else {
-		PRINT_COLOR (PALETTE(offset): Color_GREEN);
-		r_cons_printf (fmt[width], offset);
-		PRINT_COLOR (Color_RESET);
+		r_strbuf_append (sb, "    ");
+		APPEND_COLOR (ctx->offset_color);
+		r_strbuf_appendf (sb, ctx->offset_fmt, offset);
+		APPEND_COLOR (Color_RESET);
+	}
+	r_strbuf_append (sb, "    |");
+	if (color_after) {
+		APPEND_COLOR (color_after);
 	}
-	r_cons_printf("    |");
 }
 
-R_API void r_annotated_code_print(RAnnotatedCode *code, RVector *line_offsets) {
+/**
+ * Append code from *cur up to end in as few contiguous spans as possible,
+ * only interrupted by the offset bars at line starts if there are line offsets.
+ * @param span_color the color the span is printed with, to be restored after each bar, or NULL
+ */
+static void print_span(PrintCtx *ctx, size_t *cur, size_t end, const char *span_color) {
+	const char *code = ctx->code;
+	if (!ctx->line_offsets) {
+		if (*cur < end) {
+			r_strbuf_append_n (ctx->sb, code + *cur, end - *cur);
+			*cur = end;
+		}
+		return;
+	}
+	while (*cur < end) {
+		// if we are starting a new line and we are printing with offsets
+		// we need to prepare the bar with offsets on the left handside before that
+		if (*cur == 0 || code[*cur - 1] == '\n') {
+			ut64 offset = 0;
+			if (ctx->line_idx < ctx->line_offsets->len) {
+				offset = *(ut64 *)r_vector_index_ptr (ctx->line_offsets, ctx->line_idx);
+			}
+			print_offset_in_binary_line_bar (ctx, offset, span_color);
+			ctx->line_idx++;
+		}
+		const char *nl = memchr (code + *cur, '\n', end - *cur);
+		size_t stop = nl ? (size_t)(nl - code) + 1 : end;
+		r_strbuf_append_n (ctx->sb, code + *cur, stop - *cur);
+		*cur = stop;
+	}
+}
+
+R_API void r_annotated_code_print_to(RAnnotatedCode *code, RVector *line_offsets, RStrBuf *sb, bool color) {
 	if (code->annotations.len == 0) {
-		r_cons_printf("%s\n", code->code);
+		r_strbuf_appendf (sb, "%s\n", code->code);
 		return;
 	}
 
 	size_t cur = 0;
-	size_t line_idx = 0;
 	size_t len = strlen(code->code);
 
-	size_t offset_width = 0;
+	PrintCtx ctx = { 0 };
+	ctx.sb = sb;
+	ctx.code = code->code;
+	ctx.color = color;
+	ctx.line_offsets = line_offsets;
 	if (line_offsets) {
+		size_t offset_width = 0;
 		ut64 *offset;
 		ut64 offset_max = 0;
 		r_vector_foreach (line_offsets, offset) {
@@ -188,6 +359,7 @@ R_API void r_annotated_code_print(RAnnotatedCode *code, RVector *line_offsets) {
 		if (offset_width < 4) {
 			offset_width = 4;
 		}
+		print_ctx_init_offsets (&ctx, offset_width);
 	}
 
 	RCons *cons = r_cons_singleton();
@@ -200,76 +372,92 @@ R_API void r_annotated_code_print(RAnnotatedCode *code, RVector *line_offsets) {
 		// (1/3)
 		// now we have a syntax highlighting annotation.
 		// pick a suitable color for it.
-		const char* color = Color_RESET;
+		const char* span_color = Color_RESET;
 		switch (annotation->syntax_highlight.type) {
 		case R_SYNTAX_HIGHLIGHT_TYPE_COMMENT:
-			color = PALETTE(comment): Color_WHITE;
+			span_color = PALETTE(comment): Color_WHITE;
 			break;
 		case R_SYNTAX_HIGHLIGHT_TYPE_KEYWORD:
-			color = PALETTE(pop): Color_MAGENTA;
+			span_color = PALETTE(pop): Color_MAGENTA;
 			break;
 		case R_SYNTAX_HIGHLIGHT_TYPE_DATATYPE:
-			color = PALETTE(func_var_type): Color_BLUE;
+			span_color = PALETTE(func_var_type): Color_BLUE;
 			break;
 		case R_SYNTAX_HIGHLIGHT_TYPE_FUNCTION_NAME:
-			color = PALETTE(fname): Color_RED;
+			span_color = PALETTE(fname): Color_RED;
 			break;
 		case R_SYNTAX_HIGHLIGHT_TYPE_CONSTANT_VARIABLE:
-			color = PALETTE(num): Color_YELLOW;
+			span_color = PALETTE(num): Color_YELLOW;
 		default:
 			break;
 		}
 
 		// (2/3)
 		// the chunk before the syntax highlighting annotation should not be colored
-		for (; cur < annotation->start && cur < len; cur++) {
-			// if we are starting a new line and we are printing with offsets
-			// we need to prepare the bar with offsets on the left handside before that
-			if (line_offsets && (cur == 0 || code->code[cur - 1] == '\n')) {
-				ut64 offset = 0;
-				if (line_idx < line_offsets->len) {
-					offset = *(ut64 *)r_vector_index_ptr(line_offsets, line_idx);
-				}
-				print_offset_in_binary_line_bar(code, offset, offset_width);
-				line_idx++;
-			}
-			r_cons_printf("%c", code->code[cur]);
-		}
+		print_span (&ctx, &cur, R_MIN (annotation->start, len), NULL);
 
 		// (3/3)
 		// everything in between the "start" and the "end" inclusive should be highlighted
-		PRINT_COLOR (color);
-		for (; cur < annotation->end && cur < len; cur++) {
-			// if we are starting a new line and we are printing with offsets
-			// we need to prepare the bar with offsets on the left handside before that
-			if (line_offsets && (cur == 0 || code->code[cur - 1] == '\n')) {
-				ut64 offset = 0;
-				if (line_idx < line_offsets->len) {
-					offset = *(ut64 *)r_vector_index_ptr(line_offsets, line_idx);
-				}
-				PRINT_COLOR (Color_RESET);
-				print_offset_in_binary_line_bar(code, offset, offset_width);
-				PRINT_COLOR (color);
-				line_idx++;
-			}
-			r_cons_printf("%c", code->code[cur]);
-		}
-		PRINT_COLOR (Color_RESET);
+		APPEND_COLOR (span_color);
+		print_span (&ctx, &cur, R_MIN (annotation->end, len), span_color);
+		APPEND_COLOR (Color_RESET);
 	}
 	// the rest of the decompiled code should be printed
 	// without any highlighting since we don't have any annotations left
-	for (; cur < len; cur++) {
-		// if we are starting a new line and we are printing with offsets
-		// we need to prepare the bar with offsets on the left handside before that
-		if (line_offsets && (cur == 0 || code->code[cur - 1] == '\n')) {
-			ut64 offset = 0;
-			if (line_idx < line_offsets->len) {
-				offset = *(ut64 *)r_vector_index_ptr(line_offsets, line_idx);
-			}
-			print_offset_in_binary_line_bar(code, offset, offset_width);
-			line_idx++;
+	print_span (&ctx, &cur, len, NULL);
+}
+
+R_API void r_annotated_code_print(RAnnotatedCode *code, RVector *line_offsets) {
+	RStrBuf *sb = r_strbuf_new (NULL);
+	if (!sb) {
+		return;
+	}
+	RCons *cons = r_cons_singleton ();
+	r_annotated_code_print_to (code, line_offsets, sb, cons && cons->context->color_mode);
+	r_cons_print (r_strbuf_get (sb));
+	r_strbuf_free (sb);
+}
+
+/**
+ * Min-heap of annotation indices, for picking the earliest added annotation out of a changing set
+ */
+typedef struct {
+	size_t *a;
+	size_t len;
+} IndexHeap;
+
+static void heap_push(IndexHeap *heap, size_t v) {
+	size_t i = heap->len++;
+	heap->a[i] = v;
+	while (i > 0 && heap->a[(i - 1) / 2] > heap->a[i]) {
+		size_t parent = (i - 1) / 2;
+		size_t tmp = heap->a[parent];
+		heap->a[parent] = heap->a[i];
+		heap->a[i] = tmp;
+		i = parent;
+	}
+}
+
+static void heap_pop(IndexHeap *heap) {
+	heap->a[0] = heap->a[--heap->len];
+	size_t i = 0;
+	while (true) {
+		size_t smallest = i;
+		size_t l = 2 * i + 1;
+		size_t r = l + 1;
+		if (l < heap->len && heap->a[l] < heap->a[smallest]) {
+			smallest = l;
+		}
+		if (r < heap->len && heap->a[r] < heap->a[smallest]) {
+			smallest = r;
 		}
-		r_cons_printf("%c", code->code[cur]);
+		if (smallest == i) {
+			break;
+		}
+		size_t tmp = heap->a[smallest];
+		heap->a[smallest] = heap->a[i];
+		heap->a[i] = tmp;
+		i = smallest;
 	}
 }
 
@@ -278,25 +466,50 @@ R_API RVector *r_annotated_code_line_offsets(RAnnotatedCode *code) {
 	if (!r) {
 		return NULL;
 	}
+	RAnnotatedCodeIndex *index = get_index (code);
+	IndexHeap heap = { 0 };
+	heap.a = malloc (sizeof (size_t) * (code->annotations.len ? code->annotations.len : 1));
+	if (!index || !heap.a) {
+		free (heap.a);
+		r_vector_free (r);
+		return NULL;
+	}
+
+	// Single sweep over the lines and the annotations sorted by start.
+	// For each line, this picks the same annotation as the first offset annotation
+	// in r_annotated_code_annotations_range (code, line_start, line_end) would be.
+	// The heap holds all offset annotations starting up to the current line end,
+	// those ending before the current line are only dropped once they reach the top,
+	// which is fine because lines only move forward.
+	size_t next_annotation = 0;
 	size_t cur = 0;
 	size_t len = strlen (code->code);
 	do {
 		char *next = strchr (code->code + cur, '\n');
 		size_t next_i = next ? (next - code->code) + 1 : len;
-		RPVector *annotations = r_annotated_code_annotations_range (code, cur, next_i);
+		for (; next_annotation < index->count; next_annotation++) {
+			size_t idx = index->order[next_annotation];
+			const RCodeAnnotation *annotation = r_vector_index_ptr (&code->annotations, idx);
+			if (annotation->start > next_i) {
+				break;
+			}
+			if (annotation->type == R_CODE_ANNOTATION_TYPE_OFFSET) {
+				heap_push (&heap, idx);
+			}
+		}
 		ut64 offset = UT64_MAX;
-		void **it;
-		r_pvector_foreach (annotations, it) {
-			RCodeAnnotation *annotation = *it;
-			if (annotation->type != R_CODE_ANNOTATION_TYPE_OFFSET) {
-				continue;
+		while (heap.len) {
+			const RCodeAnnotation *annotation = r_vector_index_ptr (&code->annotations, heap.a[0]);
+			if (annotation->end > cur) {
+				offset = annotation->offset.offset;
+				break;
 			}
-			offset = annotation->offset.offset;
-			break;
+			heap_pop (&heap);
 		}
 		r_vector_push (r, &offset);
 		cur = next_i;
 	} while(cur < len);
+	free (heap.a);
 	return r;
 }
 
@@ -327,4 +540,130 @@ R_API void r_annotated_code_print_comment_cmds(RAnnotatedCode *code) {
 	}
 	ht_up_foreach (ht, foreach_offset_annotation, code);
 	ht_up_free (ht);
-}
\ No newline at end of file
+}
+
+#define SERIAL_MAGIC "RACD"
+#define SERIAL_VERSION 1
+#define SERIAL_HEADER_SIZE (4 + 4 + 8)
+#define SERIAL_ANNOTATION_SIZE (8 + 8 + 4 + 8)
+
+R_API ut8 *r_annotated_code_serialize(RAnnotatedCode *code, size_t *size) {
+	size_t code_len = strlen (code->code);
+	size_t count = code->annotations.len;
+	size_t len = SERIAL_HEADER_SIZE + code_len + 8 + count * SERIAL_ANNOTATION_SIZE;
+	ut8 *buf = malloc (len);
+	if (!buf) {
+		return NULL;
+	}
+	ut8 *p = buf;
+	memcpy (p, SERIAL_MAGIC, 4);
+	r_write_le32 (p + 4, SERIAL_VERSION);
+	r_write_le64 (p + 8, code_len);
+	p += SERIAL_HEADER_SIZE;
+	memcpy (p, code->code, code_len);
+	p += code_len;
+	r_write_le64 (p, count);
+	p += 8;
+	RCodeAnnotation *annotation;
+	r_vector_foreach (&code->annotations, annotation) {
+		r_write_le64 (p, annotation->start);
+		r_write_le64 (p + 8, annotation->end);
+		r_write_le32 (p + 16, annotation->type);
+		switch (annotation->type) {
+		case R_CODE_ANNOTATION_TYPE_OFFSET:
+			r_write_le64 (p + 20, annotation->offset.offset);
+			break;
+		case R_CODE_ANNOTATION_TYPE_SYNTAX_HIGHLIGHT:
+			r_write_le64 (p + 20, annotation->syntax_highlight.type);
+			break;
+		default:
+			r_write_le64 (p + 20, 0);
+			break;
+		}
+		p += SERIAL_ANNOTATION_SIZE;
+	}
+	*size = len;
+	return buf;
+}
+
+R_API RAnnotatedCode *r_annotated_code_deserialize(const ut8 *buf, size_t size) {
+	if (size < SERIAL_HEADER_SIZE || memcmp (buf, SERIAL_MAGIC, 4) || r_read_le32 (buf + 4) != SERIAL_VERSION) {
+		return NULL;
+	}
+	ut64 code_len = r_read_le64 (buf + 8);
+	size_t off = SERIAL_HEADER_SIZE;
+	if (code_len > size - off || size - off - code_len < 8) {
+		return NULL;
+	}
+	char *code_str = malloc (code_len + 1);
+	if (!code_str) {
+		return NULL;
+	}
+	memcpy (code_str, buf + off, code_len);
+	code_str[code_len] = '\0';
+	off += code_len;
+	RAnnotatedCode *code = r_annotated_code_new (code_str);
+	if (!code) {
+		free (code_str);
+		return NULL;
+	}
+	ut64 count = r_read_le64 (buf + off);
+	off += 8;
+	if (count > (size - off) / SERIAL_ANNOTATION_SIZE) {
+		r_annotated_code_free (code);
+		return NULL;
+	}
+	ut64 i;
+	for (i = 0; i < count; i++, off += SERIAL_ANNOTATION_SIZE) {
+		RCodeAnnotation annotation = { 0 };
+		annotation.start = r_read_le64 (buf + off);
+		annotation.end = r_read_le64 (buf + off + 8);
+		annotation.type = r_read_le32 (buf + off + 16);
+		if (annotation.start > annotation.end || annotation.end > code_len) {
+			r_annotated_code_free (code);
+			return NULL;
+		}
+		switch (annotation.type) {
+		case R_CODE_ANNOTATION_TYPE_OFFSET:
+			annotation.offset.offset = r_read_le64 (buf + off + 20);
+			break;
+		case R_CODE_ANNOTATION_TYPE_SYNTAX_HIGHLIGHT:
+			annotation.syntax_highlight.type = r_read_le64 (buf + off + 20);
+			break;
+		default:
+			continue;
+		}
+		r_annotated_code_add_annotation (code, &annotation);
+	}
+	return code;
+}
+
+R_API void r_annotated_code_print_serialized(RAnnotatedCode *code) {
+	size_t size;
+	ut8 *buf = r_annotated_code_serialize (code, &size);
+	if (!buf) {
+		return;
+	}
+	char *b64 = r_base64_encode_dyn ((const char *)buf, (int)size);
+	free (buf);
+	if (!b64) {
+		return;
+	}
+	r_cons_printf ("%s\n", b64);
+	free (b64);
+}
+
+R_API RAnnotatedCode *r_annotated_code_deserialize_base64(const char *str) {
+	size_t len = strlen (str);
+	while (len > 0 && (str[len - 1] == '\n' || str[len - 1] == '\r' || str[len - 1] == ' ')) {
+		len--;
+	}
+	ut8 *buf = malloc (len / 4 * 3 + 4);
+	if (!buf) {
+		return NULL;
+	}
+	int size = r_base64_decode (buf, str, (int)len);
+	RAnnotatedCode *code = size > 0 ? r_annotated_code_deserialize (buf, (size_t)size) : NULL;
+	free (buf);
+	return code;
+}
@@ -45,21 +45,60 @@ typedef struct r_code_annotation_t {
 	};
 } RCodeAnnotation;
 
+typedef struct r_annotated_code_index_t RAnnotatedCodeIndex;
+
 typedef struct r_annotated_code_t {
 	char *code; // owned
 	RVector/*<RCodeAnnotation>*/ annotations;
+	RAnnotatedCodeIndex *index; // owned, built by the first query and dropped when annotations are added
 } RAnnotatedCode;
 
 R_API RAnnotatedCode *r_annotated_code_new(char *code);
 R_API void r_annotated_code_free(RAnnotatedCode *code);
 R_API void r_annotated_code_add_annotation(RAnnotatedCode *code, RCodeAnnotation *annotation);
+/**
+ * The annotations in the returned vectors are in the order they were added
+ */
 R_API RPVector *r_annotated_code_annotations_in(RAnnotatedCode *code, size_t offset);
 R_API RPVector *r_annotated_code_annotations_range(RAnnotatedCode *code, size_t start, size_t end);
+/**
+ * Add the "code" and "annotations" members to the object currently open in pj
+ */
+R_API void r_annotated_code_json(RAnnotatedCode *code, PJ *pj);
 R_API void r_annotated_code_print_json(RAnnotatedCode *code);
 R_API void r_annotated_code_print(RAnnotatedCode *code, RVector *line_offsets);
+
+/**
+ * Same as r_annotated_code_print(), but appends to sb instead of printing to the console
+ * @param color whether to include color codes, the colors are taken from the console's palette
+ */
+R_API void r_annotated_code_print_to(RAnnotatedCode *code, RVector *line_offsets, RStrBuf *sb, bool color);
 R_API RVector *r_annotated_code_line_offsets(RAnnotatedCode *code);
 R_API void r_annotated_code_print_comment_cmds(RAnnotatedCode *code);
 
+/**
+ * Versioned binary representation of code and annotations, independent of the host's struct layout
+ * @param size receives the size of the returned buffer
+ * @return buffer to be freed with free()
+ */
+R_API ut8 *r_annotated_code_serialize(RAnnotatedCode *code, size_t *size);
+
+/**
+ * @return NULL if buf is not a valid serialization of the current version
+ */
+R_API RAnnotatedCode *r_annotated_code_deserialize(const ut8 *buf, size_t size);
+
+/**
+ * Print the serialization as a single line of base64, as the console and r2pipe can not carry raw binary data
+ */
+R_API void r_annotated_code_print_serialized(RAnnotatedCode *code);
+
+/**
+ * Decode the output of r_annotated_code_print_serialized()
+ * @return NULL if str is not a valid serialization of the current version
+ */
+R_API RAnnotatedCode *r_annotated_code_deserialize_base64(const char *str);
+
 #ifdef __cplusplus
 }
 #endif
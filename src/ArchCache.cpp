@@ -0,0 +1,92 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#include "ArchCache.h"
+#include "R2Architecture.h"
+#include "ArchMap.h"
+#include "DecompileProfile.h"
+
+#include <r_core.h>
+
+#include <sstream>
+
+ArchCache::ArchCache(size_t capacity)
+	: capacity(capacity)
+{
+}
+
+ArchCache::~ArchCache()
+{
+	clear();
+}
+
+static std::string BinaryIdFromCore(RCore *core)
+{
+	std::stringstream ss;
+	RBinFile *bf = r_bin_cur(core->bin);
+	if(bf)
+		ss << bf->id << ":" << (bf->file ? bf->file : "");
+	return ss.str();
+}
+
+ArchCache::Lease::Lease(ArchCache *cache, std::string key, std::unique_ptr<R2Architecture> arch)
+	: cache(cache), key(std::move(key)), arch(std::move(arch))
+{
+}
+
+ArchCache::Lease::~Lease()
+{
+	if(arch)
+		cache->checkin(key, std::move(arch));
+}
+
+ArchCache::Lease ArchCache::checkout(RCore *core, const std::string &sleigh_id, bool rawptr, bool fast, DecompileProfile *profile, bool fresh)
+{
+	std::string id = sleigh_id.empty() ? SleighIdFromCore(core) : sleigh_id;
+	std::string key = id + "|" + BinaryIdFromCore(core) + "|" + (rawptr ? "rawptr" : "") + "|" + (fast ? "fast" : "");
+
+	std::unique_ptr<R2Architecture> arch;
+	if(!fresh)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for(auto it = entries.begin(); it != entries.end(); it++)
+		{
+			if(it->key != key)
+				continue;
+			arch = std::move(it->arch);
+			entries.erase(it);
+			break;
+		}
+	}
+
+	if(arch)
+	{
+		arch->setProfile(profile);
+		arch->resetFunctionState();
+	}
+	else
+	{
+		ProfileTimer timer(profile, DecompileProfile::ARCH_INIT);
+		arch.reset(new R2Architecture(core, id));
+		DocumentStorage store;
+		arch->setRawPtr(rawptr);
+		arch->setFast(fast);
+		arch->setProfile(profile);
+		arch->init(store);
+	}
+	return Lease(this, key, std::move(arch));
+}
+
+void ArchCache::checkin(const std::string &key, std::unique_ptr<R2Architecture> arch)
+{
+	arch->setProfile(nullptr);
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.push_front({ key, std::move(arch) });
+	while(entries.size() > capacity)
+		entries.pop_back();
+}
+
+void ArchCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.clear();
+}
@@ -0,0 +1,85 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#ifndef R2GHIDRA_ARCHCACHE_H
+#define R2GHIDRA_ARCHCACHE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class R2Architecture;
+class DecompileProfile;
+typedef struct r_core_t RCore;
+
+/**
+ * Keeps initialized R2Architectures alive between decompilations,
+ * so the translator, type factory and action database are only built once per session.
+ * Entries are keyed by Sleigh ID, binary identity and the options that influence the actions.
+ *
+ * Architectures are checked out exclusively, so concurrent decompilations never share one.
+ * If all matching architectures are in use, a new one is created.
+ */
+class ArchCache
+{
+	public:
+		/**
+		 * Exclusive use of an architecture, which goes back to the cache when the lease is destroyed
+		 */
+		class Lease
+		{
+			friend class ArchCache;
+
+			private:
+				ArchCache *cache;
+				std::string key;
+				std::unique_ptr<R2Architecture> arch;
+
+				Lease(ArchCache *cache, std::string key, std::unique_ptr<R2Architecture> arch);
+
+			public:
+				Lease(Lease &&other) = default;
+				~Lease();
+
+				R2Architecture *operator->() const	{ return arch.get(); }
+				R2Architecture &operator*() const	{ return *arch; }
+		};
+
+	private:
+		struct Entry
+		{
+			std::string key;
+			std::unique_ptr<R2Architecture> arch;
+		};
+
+		const size_t capacity;
+
+		std::mutex mutex;
+
+		/**
+		 * Architectures not checked out, most recently used first
+		 */
+		std::list<Entry> entries;
+
+		void checkin(const std::string &key, std::unique_ptr<R2Architecture> arch);
+
+	public:
+		explicit ArchCache(size_t capacity = 4);
+		~ArchCache();
+
+		/**
+		 * Get an initialized architecture for the current binary in core
+		 * The returned architecture is already reset for decompiling a new function.
+		 * The caller must hold the language lock.
+		 *
+		 * @param fast use the reduced action group, see R2Architecture::setFast()
+		 * @param profile set on the architecture until the lease ends, also records the initialization
+		 * @param fresh always initialize a new architecture, which still goes into the cache afterwards
+		 */
+		Lease checkout(RCore *core, const std::string &sleigh_id, bool rawptr, bool fast, DecompileProfile *profile = nullptr,
+				bool fresh = false);
+
+		void clear();
+};
+
+#endif //R2GHIDRA_ARCHCACHE_H
@@ -8,8 +8,11 @@
 
 #include <funcdata.hh>
 #include <r_util.h>
-#include <pugixml.hpp>
-#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <ostream>
 #include <string>
 
 struct ParseCodeXMLContext
@@ -24,16 +27,31 @@ struct ParseCodeXMLContext
 	}
 };
 
-#define ANNOTATOR_PARAMS pugi::xml_node node, ParseCodeXMLContext *ctx, std::vector<RCodeAnnotation> *out
+/**
+ * Attribute access of an element for the annotators
+ */
+class CodeXMLNode
+{
+	public:
+		virtual ~CodeXMLNode() = default;
+
+		/**
+		 * @return the unescaped value or nullptr if there is no such attribute
+		 */
+		virtual const char *attribute(const char *name) const = 0;
+};
+
+#define ANNOTATOR_PARAMS const CodeXMLNode &node, ParseCodeXMLContext *ctx, std::vector<RCodeAnnotation> *out
 #define ANNOTATOR [](ANNOTATOR_PARAMS) -> void
 
 void AnnotateOpref(ANNOTATOR_PARAMS)
 {
-	pugi::xml_attribute attr = node.attribute("opref");
-	if(attr.empty())
+	const char *attr = node.attribute("opref");
+	if(!attr || !*attr)
 		return;
-	unsigned long long opref = attr.as_ullong(ULLONG_MAX);
-	if(opref == ULLONG_MAX)
+	char *end;
+	unsigned long long opref = strtoull(attr, &end, 0);
+	if(*end || opref == ULLONG_MAX)
 		return;
 	auto opit = ctx->ops.find((uintm)opref);
 	if(opit == ctx->ops.end())
@@ -53,11 +71,11 @@ void AnnotateOpref(ANNOTATOR_PARAMS)
  **/
 void AnnotateColor(ANNOTATOR_PARAMS)
 {
-	pugi::xml_attribute attr = node.attribute("color");
-	if (attr.empty())
+	const char *attr = node.attribute("color");
+	if (!attr)
 		return;
 
-	std::string color = attr.as_string();
+	std::string color = attr;
 	if (color == "")
 		return;
 
@@ -96,98 +114,280 @@ static const std::map<std::string, std::vector <void (*)(ANNOTATOR_PARAMS)> > an
 	{ "syntax", { AnnotateColor } }
 };
 
-//#define TEST_UNKNOWN_NODES
+namespace
+{
+
+class StreamCodeXMLNode : public CodeXMLNode
+{
+	private:
+		const std::vector<std::pair<std::string, std::string>> &attrs;
+
+	public:
+		explicit StreamCodeXMLNode(const std::vector<std::pair<std::string, std::string>> &attrs) : attrs(attrs) {}
+
+		const char *attribute(const char *name) const override
+		{
+			for(const auto &attr : attrs)
+			{
+				if(attr.first == name)
+					return attr.second.c_str();
+			}
+			return nullptr;
+		}
+};
+
+}
 
 /**
- * Ghidra returns an annotated AST of the decompiled high-level language code.
- * The AST is saved in XML format.
- *
- * This function is a DFS traversal over Ghidra's AST.
- * It parses some of the annotatations (e.g. decompilation offsets, token classes, ..)
- * and translates them into a suitable format
- * that can be natively saved in the RAnnotatedCode structure.
- **/
-static void ParseNode(pugi::xml_node node, ParseCodeXMLContext *ctx, std::ostream &stream, RAnnotatedCode *code)
+ * Incremental parser for the markup written by Ghidra's EmitXml.
+ * Only handles what EmitXml produces: elements, attributes in double quotes and the standard entities.
+ */
+class CodeXMLStreamBuf : public std::streambuf
 {
-	// A leaf is an XML node which contains parts of the high level decompilation language
-	if(node.type() == pugi::xml_node_type::node_pcdata)
-	{
-		stream << node.value();
-		return;
-	}
+	private:
+		struct Frame
+		{
+			std::vector<RCodeAnnotation> annotations;
+		};
 
-	std::vector<RCodeAnnotation> annotations;
-#ifdef TEST_UNKNOWN_NODES
-	bool close_test = false;
-	static const std::set<std::string> boring_tags = { "syntax" };
-#endif
+		ParseCodeXMLContext ctx;
+		std::string code;
+		std::vector<Frame> stack;
+		std::vector<RCodeAnnotation> finished;
+		bool in_tag = false;
+		bool in_quote = false;
+		bool in_entity = false;
+		bool failed = false;
+		std::string tag;
+		std::string entity;
+		std::vector<std::pair<std::string, std::string>> attrs; // reused for every tag
 
-	if(strcmp(node.name(), "break") == 0)
-	{
-		stream << "\n";
-		stream << std::string(node.attribute("indent").as_uint(0), ' ');
-	}
-	else
-	{
-		auto it = annotators.find(node.name());
-		if(it != annotators.end())
+		static void decodeEntity(const std::string &entity, std::string &out)
 		{
-			auto &callbacks = it->second;
-			for (auto &callback : callbacks)
-				callback(node, ctx, &annotations);
-			for(auto &annotation : annotations)
-				annotation.start = stream.tellp();
+			if(entity == "lt")
+				out += '<';
+			else if(entity == "gt")
+				out += '>';
+			else if(entity == "amp")
+				out += '&';
+			else if(entity == "quot")
+				out += '"';
+			else if(entity == "apos")
+				out += '\'';
+			else if(entity.size() > 1 && entity[0] == '#')
+			{
+				unsigned long c = entity[1] == 'x'
+						? strtoul(entity.c_str() + 2, nullptr, 16)
+						: strtoul(entity.c_str() + 1, nullptr, 10);
+				if(c < 0x80)
+					out += (char)c;
+				else
+					out += "&" + entity + ";"; // never emitted by the decompiler
+			}
+			else
+				out += "&" + entity + ";";
 		}
-#ifdef TEST_UNKNOWN_NODES
-		else if(boring_tags.find(node.name()) == boring_tags.end())
+
+		static std::string unescape(const char *begin, const char *end)
 		{
-			close_test = true;
-			stream << "<" << node.name();
-			for(pugi::xml_attribute attr : node.attributes())
-				stream << " " << attr.name() << "=\"" << attr.value() << "\""; // unescaped, but who cares
-			stream << ">";
+			std::string r;
+			while(begin < end)
+			{
+				const char *amp = std::find(begin, end, '&');
+				r.append(begin, amp);
+				if(amp == end)
+					break;
+				const char *semi = std::find(amp, end, ';');
+				if(semi == end)
+				{
+					r.append(amp, end);
+					break;
+				}
+				decodeEntity(std::string(amp + 1, semi), r);
+				begin = semi + 1;
+			}
+			return r;
 		}
-#endif
-	}
 
-	for(pugi::xml_node child : node)
-		ParseNode(child, ctx, stream, code);
+		void parseAttributes(const char *p, const char *end)
+		{
+			attrs.clear();
+			while(p < end)
+			{
+				while(p < end && isspace((unsigned char)*p))
+					p++;
+				const char *name = p;
+				while(p < end && *p != '=' && !isspace((unsigned char)*p))
+					p++;
+				if(p == name)
+					break;
+				std::string attr_name(name, p);
+				while(p < end && *p != '"')
+					p++;
+				if(p == end)
+					break;
+				const char *value = ++p;
+				while(p < end && *p != '"')
+					p++;
+				attrs.emplace_back(attr_name, unescape(value, p));
+				if(p < end)
+					p++;
+			}
+		}
 
-	// an annotation applies for a node an all its children
-	for(auto &annotation : annotations)
-	{
-		annotation.end = stream.tellp();
-		r_annotated_code_add_annotation(code, &annotation);
-	}
+		void closeFrame()
+		{
+			if(stack.empty())
+			{
+				failed = true;
+				return;
+			}
+			// an annotation applies for a node an all its children
+			for(auto &annotation : stack.back().annotations)
+			{
+				annotation.end = code.size();
+				finished.push_back(annotation);
+			}
+			stack.pop_back();
+		}
 
-#ifdef TEST_UNKNOWN_NODES
-	if(close_test)
-		stream << "</" << node.name() << ">";
-#endif
-}
+		void handleTag()
+		{
+			if(tag.empty() || tag[0] == '?' || tag[0] == '!')
+				return;
+			if(tag[0] == '/')
+			{
+				closeFrame();
+				return;
+			}
 
-R_API RAnnotatedCode *ParseCodeXML(Funcdata *func, const char *xml)
-{
-	pugi::xml_document doc;
-	if(!doc.load_string(xml, pugi::parse_default | pugi::parse_ws_pcdata))
-		return nullptr;
+			bool self_closing = tag.back() == '/';
+			const char *begin = tag.c_str();
+			const char *end = begin + tag.size() - (self_closing ? 1 : 0);
+			const char *name_end = begin;
+			while(name_end < end && !isspace((unsigned char)*name_end))
+				name_end++;
+			std::string name(begin, name_end);
+			parseAttributes(name_end, end);
+
+			stack.emplace_back();
+			if(name == "break")
+			{
+				if(stack.size() > 1)
+				{
+					StreamCodeXMLNode node(attrs);
+					const char *indent = node.attribute("indent");
+					code += '\n';
+					code.append(indent ? strtoul(indent, nullptr, 10) : 0, ' ');
+				}
+			}
+			else
+			{
+				auto it = annotators.find(name);
+				if(it != annotators.end())
+				{
+					StreamCodeXMLNode node(attrs);
+					auto &annotations = stack.back().annotations;
+					for(auto &callback : it->second)
+						callback(node, &ctx, &annotations);
+					for(auto &annotation : annotations)
+						annotation.start = code.size();
+				}
+			}
 
-	std::stringstream ss;
-	RAnnotatedCode *code = r_annotated_code_new(nullptr);
-	if(!code)
-		return nullptr;
+			if(self_closing)
+				closeFrame();
+		}
 
-	ParseCodeXMLContext ctx(func);
-	ParseNode(doc.child("function"), &ctx, ss, code);
+		void put(char c)
+		{
+			if(in_tag)
+			{
+				if(c == '"')
+					in_quote = !in_quote;
+				else if(c == '>' && !in_quote)
+				{
+					handleTag();
+					tag.clear();
+					in_tag = false;
+					return;
+				}
+				tag += c;
+			}
+			else if(in_entity)
+			{
+				if(c == ';')
+				{
+					if(!stack.empty())
+						decodeEntity(entity, code);
+					entity.clear();
+					in_entity = false;
+				}
+				else
+					entity += c;
+			}
+			else if(c == '<')
+				in_tag = true;
+			else if(c == '&')
+				in_entity = true;
+			else if(!stack.empty()) // only text inside of the root element is code
+				code += c;
+		}
 
-	std::string str = ss.str();
-	code->code = reinterpret_cast<char *>(r_malloc(str.length() + 1));
-	if(!code->code)
-	{
-		r_annotated_code_free(code);
-		return nullptr;
-	}
-	memcpy(code->code, str.c_str(), str.length());
-	code->code[str.length()] = '\0';
-	return code;
+	protected:
+		int_type overflow(int_type c) override
+		{
+			if(!traits_type::eq_int_type(c, traits_type::eof()))
+				put(traits_type::to_char_type(c));
+			return traits_type::not_eof(c);
+		}
+
+		std::streamsize xsputn(const char *s, std::streamsize n) override
+		{
+			for(std::streamsize i = 0; i < n; i++)
+				put(s[i]);
+			return n;
+		}
+
+	public:
+		explicit CodeXMLStreamBuf(Funcdata *func) : ctx(func) {}
+
+		RAnnotatedCode *takeCode()
+		{
+			if(failed || in_tag || !stack.empty())
+				return nullptr;
+
+			RAnnotatedCode *r = r_annotated_code_new(nullptr);
+			if(!r)
+				return nullptr;
+			r->code = reinterpret_cast<char *>(r_malloc(code.length() + 1));
+			if(!r->code)
+			{
+				r_annotated_code_free(r);
+				return nullptr;
+			}
+			memcpy(r->code, code.c_str(), code.length());
+			r->code[code.length()] = '\0';
+			for(auto &annotation : finished)
+				r_annotated_code_add_annotation(r, &annotation);
+
+			code.clear();
+			finished.clear();
+			return r;
+		}
+};
+
+CodeXMLStream::CodeXMLStream(Funcdata *func)
+	: std::ostream(nullptr),
+	buf(new CodeXMLStreamBuf(func))
+{
+	rdbuf(buf.get());
+}
+
+CodeXMLStream::~CodeXMLStream() = default;
+
+RAnnotatedCode *CodeXMLStream::takeCode()
+{
+	flush();
+	return buf->takeCode();
 }
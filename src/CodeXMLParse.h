@@ -5,8 +5,30 @@
 
 #include "AnnotatedCode.h"
 
+#include <memory>
+#include <ostream>
+
 class Funcdata;
+class CodeXMLStreamBuf;
+
+/**
+ * Output stream for the decompiler's xml markup (PrintLanguage::setXML(true)),
+ * which builds the RAnnotatedCode while the markup is being emitted
+ * instead of keeping the markup and parsing it into a DOM afterwards.
+ */
+class CodeXMLStream : public std::ostream
+{
+	private:
+		std::unique_ptr<CodeXMLStreamBuf> buf;
+
+	public:
+		explicit CodeXMLStream(Funcdata *func);
+		~CodeXMLStream() override;
 
-R_API RAnnotatedCode *ParseCodeXML(Funcdata *func, const char *xml);
+		/**
+		 * @return the code emitted so far, or nullptr if the markup was malformed
+		 */
+		RAnnotatedCode *takeCode();
+};
 
 #endif //R2GHIDRA_CODEXMLPARSE_H
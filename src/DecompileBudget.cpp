@@ -0,0 +1,100 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#include "DecompileBudget.h"
+
+void DecompileBudget::start()
+{
+	start_time = std::chrono::steady_clock::now();
+	iterations = 0;
+	exceeded = Exceeded::NONE;
+}
+
+bool DecompileBudget::check(bool iteration)
+{
+	if(exceeded != Exceeded::NONE)
+		return true;
+	if(checkCancel())
+		return true;
+	if(iteration && max_iterations && ++iterations > max_iterations)
+		exceeded = Exceeded::ITERATIONS;
+	else if(timeout_ms && std::chrono::steady_clock::now() - start_time > std::chrono::milliseconds(timeout_ms))
+		exceeded = Exceeded::TIME;
+	return exceeded != Exceeded::NONE;
+}
+
+bool DecompileBudget::checkCancel()
+{
+	if(exceeded == Exceeded::NONE && cancel && cancel())
+		exceeded = Exceeded::CANCELLED;
+	return exceeded == Exceeded::CANCELLED;
+}
+
+std::string DecompileBudget::describe() const
+{
+	switch(exceeded)
+	{
+		case Exceeded::TIME:
+			return "exceeding the time budget of " + std::to_string(timeout_ms) + " ms";
+		case Exceeded::ITERATIONS:
+			return "exceeding the budget of " + std::to_string(max_iterations) + " iterations";
+		case Exceeded::CANCELLED:
+			return "being cancelled";
+		default:
+			return "exceeding the budget";
+	}
+}
+
+ActionBudget::ActionBudget(DecompileBudget *budget, bool iteration, const string &g)
+	: Action(0, iteration ? "budgetloop" : "budget", g), budget(budget), iteration(iteration)
+{
+}
+
+Action *ActionBudget::clone(const ActionGroupList &grouplist) const
+{
+	if(!grouplist.contains(getGroup()))
+		return nullptr;
+	return new ActionBudget(budget, iteration, getGroup());
+}
+
+int4 ActionBudget::apply(Funcdata &data)
+{
+	return budget->check(iteration) ? -1 : 0;
+}
+
+void ActionBudget::install(Action *root, DecompileBudget *budget)
+{
+	auto mainloop = dynamic_cast<ActionGroup *>(root->getSubAction("mainloop"));
+	if(mainloop)
+		mainloop->addAction(new ActionBudget(budget, true, "base"));
+	auto stackstall = dynamic_cast<ActionGroup *>(root->getSubAction("stackstall"));
+	if(stackstall)
+		stackstall->addAction(new ActionBudget(budget, false, "base"));
+	auto oppool = dynamic_cast<ActionPool *>(root->getSubAction("oppool1"));
+	if(oppool)
+		oppool->addRule(new RuleBudget(budget, "base"));
+}
+
+RuleBudget::RuleBudget(DecompileBudget *budget, const string &g)
+	: Rule(g, 0, "budget"), budget(budget)
+{
+}
+
+Rule *RuleBudget::clone(const ActionGroupList &grouplist) const
+{
+	if(!grouplist.contains(getGroup()))
+		return nullptr;
+	return new RuleBudget(budget, getGroup());
+}
+
+void RuleBudget::getOpList(vector<uint4> &oplist) const
+{
+	for(uint4 opc = CPUI_COPY; opc < CPUI_MAX; opc++)
+		oplist.push_back(opc);
+}
+
+int4 RuleBudget::applyOp(PcodeOp *op, Funcdata &data)
+{
+	if((++ops & 0xff) == 0 && budget->checkCancel())
+		throw LowlevelError("Decompilation cancelled");
+	return 0;
+}
@@ -0,0 +1,102 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#ifndef R2GHIDRA_DECOMPILEBUDGET_H
+#define R2GHIDRA_DECOMPILEBUDGET_H
+
+#include <action.hh>
+
+#include <r_types.h>
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+/**
+ * Wall-clock and iteration limits for a single decompilation, plus cancellation from the outside.
+ * Enforced by ActionBudget, which makes the current action return like a breakpoint once a limit is exceeded,
+ * and RuleBudget, which aborts with an exception when cancelled in the middle of a rule pool.
+ */
+class DecompileBudget
+{
+	private:
+		enum class Exceeded { NONE, TIME, ITERATIONS, CANCELLED };
+
+		std::chrono::steady_clock::time_point start_time;
+		ut64 iterations = 0;
+		Exceeded exceeded = Exceeded::NONE;
+
+	public:
+		ut64 timeout_ms = 0; // 0 for no limit
+		ut64 max_iterations = 0; // passes of the main simplification loop, 0 for no limit
+
+		/**
+		 * Polled from the decompiling thread while the action runs, returns true to cancel the decompilation
+		 */
+		std::function<bool()> cancel;
+
+		void start();
+
+		/**
+		 * @param iteration whether this check marks another pass of the main loop
+		 * @return true if a limit has been exceeded
+		 */
+		bool check(bool iteration);
+
+		/**
+		 * Only poll cancel, for frequent checks where measuring time is too expensive
+		 * @return true if cancelled
+		 */
+		bool checkCancel();
+
+		bool isExceeded() const	{ return exceeded != Exceeded::NONE; }
+		bool isCancelled() const	{ return exceeded == Exceeded::CANCELLED; }
+
+		/**
+		 * @return human-readable reason why the decompilation stopped, e.g. "exceeding the budget of 5 iterations"
+		 */
+		std::string describe() const;
+};
+
+/**
+ * Checks a DecompileBudget every time its group is applied and returns -1 once it is exceeded,
+ * which unwinds Action::perform() the same way a breakpoint does.
+ */
+class ActionBudget : public Action
+{
+	private:
+		DecompileBudget *budget;
+		bool iteration;
+
+	public:
+		ActionBudget(DecompileBudget *budget, bool iteration, const string &g);
+
+		Action *clone(const ActionGroupList &grouplist) const override;
+		int4 apply(Funcdata &data) override;
+
+		/**
+		 * Append budget checks to the main loop and to the inner stack stall loop of root,
+		 * and a RuleBudget to its main rule pool
+		 */
+		static void install(Action *root, DecompileBudget *budget);
+};
+
+/**
+ * Matches every op of the pool it is in and throws once the budget is cancelled,
+ * so a cancel also interrupts a single long pass over all ops.
+ * Only polls every few hundred ops to keep the overhead negligible.
+ */
+class RuleBudget : public Rule
+{
+	private:
+		DecompileBudget *budget;
+		uint4 ops = 0;
+
+	public:
+		RuleBudget(DecompileBudget *budget, const string &g);
+
+		Rule *clone(const ActionGroupList &grouplist) const override;
+		void getOpList(vector<uint4> &oplist) const override;
+		int4 applyOp(PcodeOp *op, Funcdata &data) override;
+};
+
+#endif //R2GHIDRA_DECOMPILEBUDGET_H
@@ -0,0 +1,313 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#include "DecompileCache.h"
+#include "R2Snapshot.h"
+#include "R2TypeFactory.h"
+
+#include <r_core.h>
+#include <r_hash.h>
+
+#include "R2Utils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+// bump when anything changes that is not covered by the key, e.g. the decompiler itself
+#define CACHE_KEY_VERSION "r2ghidra-cache-1"
+
+static void AppendKey(std::string &blob, const std::string &s)
+{
+	blob += s;
+	blob += '\0';
+}
+
+static void AppendKey(std::string &blob, ut64 v)
+{
+	AppendKey(blob, std::to_string(v));
+}
+
+static std::string Sha256Hex(const std::string &blob)
+{
+	RHash *ctx = r_hash_new(true, R_HASH_SHA256);
+	if(!ctx)
+		return std::string();
+	const ut8 *digest = r_hash_do_sha256(ctx, reinterpret_cast<const ut8 *>(blob.data()), (int)blob.size());
+	std::stringstream ss;
+	ss << std::hex;
+	for(int i = 0; i < R_HASH_SIZE_SHA256; i++)
+		ss << ((digest[i] >> 4) & 0xf) << (digest[i] & 0xf);
+	r_hash_free(ctx);
+	return ss.str();
+}
+
+/**
+ * Digest of all of r2's types, only computed again after the sdb hook of R2TypeFactory saw a change
+ */
+static std::string TypesDigest(RCore *core)
+{
+	static std::mutex mutex;
+	static bool valid = false;
+	static ut64 generation;
+	static std::string digest;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	ut64 cur = R2TypeFactory::getSdbTypesGeneration();
+	if(valid && cur == generation)
+		return digest;
+
+	// sorted to get the same digest across sessions
+	std::string blob;
+	SdbList *kvs = sdb_foreach_list(core->anal->sdb_types, true);
+	SdbListIter *kv_iter;
+	SdbKv *kv;
+	ls_foreach(kvs, kv_iter, kv)
+	{
+		AppendKey(blob, sdbkv_key(kv) ? sdbkv_key(kv) : "");
+		AppendKey(blob, sdbkv_value(kv) ? sdbkv_value(kv) : "");
+	}
+	ls_free(kvs);
+
+	digest = Sha256Hex(blob);
+	generation = cur;
+	valid = true;
+	return digest;
+}
+
+std::string DecompileCache::computeKey(RCore *core, RAnalFunction *fcn, const std::string &context, bool full)
+{
+	std::string blob;
+	AppendKey(blob, CACHE_KEY_VERSION);
+	AppendKey(blob, context);
+
+	R2Snapshot::Function function = R2Snapshot::captureFunction(core, fcn);
+	AppendKey(blob, function.addr);
+	AppendKey(blob, function.name);
+	AppendKey(blob, function.cc);
+	AppendKey(blob, function.thumb);
+	AppendKey(blob, function.noreturn);
+	AppendKey(blob, function.anal_bits);
+	for(const auto &var : function.vars)
+	{
+		AppendKey(blob, var.name);
+		AppendKey(blob, var.type);
+		AppendKey(blob, var.regname);
+		AppendKey(blob, var.kind);
+		AppendKey(blob, var.delta);
+		AppendKey(blob, var.isarg);
+	}
+
+	std::vector<ut8> bytes;
+	for(const auto &range : function.ranges)
+	{
+		AppendKey(blob, range.first);
+		AppendKey(blob, range.second);
+		if(range.second <= range.first)
+			continue;
+		bytes.resize(range.second - range.first);
+		r_io_read_at(core->io, range.first, bytes.data(), (int)bytes.size());
+		blob.append(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+	}
+
+	// everything the function references: callees with their prototypes, which affect the control flow and the calls,
+	// and the symbol flags of imports, strings and globals, whose names end up in the output
+	std::vector<ut64> targets;
+	RList *refs = r_anal_function_get_refs(fcn);
+	if(refs)
+	{
+		r_list_foreach_cpp<RAnalRef>(refs, [&](RAnalRef *ref) {
+			targets.push_back(ref->addr);
+		});
+		r_list_free(refs);
+	}
+	std::sort(targets.begin(), targets.end());
+	targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+	for(ut64 target : targets)
+	{
+		AppendKey(blob, target);
+		RAnalFunction *callee = r_anal_get_function_at(core->anal, target);
+		if(callee)
+		{
+			// the callee's prototype, as R2Scope registers it, determines how calls to it are rendered
+			R2Snapshot::Function proto = R2Snapshot::captureFunction(core, callee);
+			AppendKey(blob, proto.name);
+			AppendKey(blob, proto.cc);
+			AppendKey(blob, proto.noreturn);
+			for(const auto &var : proto.vars)
+			{
+				if(!var.isarg)
+					continue;
+				AppendKey(blob, var.name);
+				AppendKey(blob, var.type);
+				AppendKey(blob, var.regname);
+				AppendKey(blob, var.kind);
+				AppendKey(blob, var.delta);
+			}
+		}
+		RFlagItem *flag_item = R2Snapshot::symbolFlagAt(core, target);
+		if(flag_item)
+		{
+			R2Snapshot::Flag flag = R2Snapshot::captureFlag(core, flag_item);
+			AppendKey(blob, flag.name);
+			AppendKey(blob, flag.size);
+			AppendKey(blob, flag.is_string);
+		}
+	}
+
+	if(full)
+	{
+		// the same comments that R2CommentDatabase loads for the function
+		for(const auto &range : MergeRanges(function.ranges))
+		{
+			RPVector *nodes = r_meta_get_all_intersect(core->anal, range.first, range.second - range.first, R_META_TYPE_COMMENT);
+			if(!nodes)
+				continue;
+			for(size_t i = 0; i < r_pvector_len(nodes); i++)
+			{
+				auto node = reinterpret_cast<RIntervalNode *>(r_pvector_at(nodes, i));
+				auto meta = reinterpret_cast<RAnalMetaItem *>(node->data);
+				if(!meta || !meta->str || node->start < range.first)
+					continue;
+				AppendKey(blob, node->start);
+				AppendKey(blob, meta->str);
+			}
+			r_pvector_free(nodes);
+		}
+
+		AppendKey(blob, TypesDigest(core));
+	}
+
+	return Sha256Hex(blob);
+}
+
+static std::string CachePath(const std::string &dir, const std::string &key)
+{
+	return dir + R_SYS_DIR + key + ".r2gc";
+}
+
+RAnnotatedCode *DecompileCache::load(const std::string &dir, const std::string &key)
+{
+	if(dir.empty() || key.empty())
+		return nullptr;
+	std::ifstream file(CachePath(dir, key), std::ios::binary);
+	if(!file)
+		return nullptr;
+	std::vector<char> buf((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return r_annotated_code_deserialize(reinterpret_cast<const ut8 *>(buf.data()), buf.size());
+}
+
+bool DecompileCache::store(const std::string &dir, const std::string &key, RAnnotatedCode *code)
+{
+	if(dir.empty() || key.empty())
+		return false;
+	if(!r_file_is_directory(dir.c_str()) && !r_sys_mkdirp(dir.c_str()))
+		return false;
+
+	size_t size;
+	ut8 *buf = r_annotated_code_serialize(code, &size);
+	if(!buf)
+		return false;
+
+	// write to a temporary file first, so concurrent sessions never see partial entries
+	std::string path = CachePath(dir, key);
+	std::string tmp_path = path + "." + std::to_string(r_sys_getpid()) + ".tmp";
+	bool r;
+	{
+		std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char *>(buf), size);
+		r = file.good();
+	}
+	free(buf);
+	if(!r || std::rename(tmp_path.c_str(), path.c_str()) != 0)
+	{
+		std::remove(tmp_path.c_str());
+		return false;
+	}
+	return true;
+}
+
+DecompileMemoryCache::~DecompileMemoryCache()
+{
+	unhook();
+}
+
+void DecompileMemoryCache::trim()
+{
+	while(entries.size() > capacity)
+		entries.pop_back();
+}
+
+void DecompileMemoryCache::setCapacity(size_t capacity)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	this->capacity = capacity;
+	trim();
+}
+
+std::shared_ptr<RAnnotatedCode> DecompileMemoryCache::get(const std::string &key)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	ut64 cur = generation;
+	for(auto it = entries.begin(); it != entries.end(); it++)
+	{
+		if(it->key != key)
+			continue;
+		if(it->generation != cur)
+		{
+			entries.erase(it);
+			return nullptr;
+		}
+		entries.splice(entries.begin(), entries, it);
+		return entries.front().code;
+	}
+	return nullptr;
+}
+
+void DecompileMemoryCache::put(const std::string &key, const std::shared_ptr<RAnnotatedCode> &code, ut64 generation)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if(!capacity)
+		return;
+	entries.remove_if([&key](const Entry &entry) { return entry.key == key; });
+	entries.push_front({ key, generation, code });
+	trim();
+}
+
+void DecompileMemoryCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.clear();
+}
+
+void DecompileMemoryCache::EventCb(REvent *ev, int type, void *user, void *data)
+{
+	reinterpret_cast<DecompileMemoryCache *>(user)->generation++;
+}
+
+int DecompileMemoryCache::TypesHookCb(void *s, void *user, const char *k, const char *v)
+{
+	reinterpret_cast<DecompileMemoryCache *>(user)->generation++;
+	return 0;
+}
+
+void DecompileMemoryCache::hook(RCore *core)
+{
+	unhook();
+	this->core = core;
+	// meta (comments) and class changes
+	event_handle = r_event_hook(core->anal->ev, R_EVENT_ALL, EventCb, this);
+	sdb_hook(core->anal->sdb_types, TypesHookCb, this);
+}
+
+void DecompileMemoryCache::unhook()
+{
+	if(!core)
+		return;
+	r_event_unhook(core->anal->ev, event_handle);
+	sdb_unhook(core->anal->sdb_types, TypesHookCb);
+	core = nullptr;
+}
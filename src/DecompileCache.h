@@ -0,0 +1,107 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#ifndef R2GHIDRA_DECOMPILECACHE_H
+#define R2GHIDRA_DECOMPILECACHE_H
+
+#include "AnnotatedCode.h"
+
+#include <r_event.h>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+typedef struct r_core_t RCore;
+typedef struct r_anal_function_t RAnalFunction;
+
+/**
+ * On-disk cache of decompiled functions, one file per function named by a sha256 key
+ * over everything the decompilation depends on.
+ */
+class DecompileCache
+{
+	public:
+		/**
+		 * Compute the key for fcn from its bytes, the r2 metadata that R2Scope registers for it
+		 * and the functions and flags at the targets of its references (callee prototypes, flag names and sizes).
+		 * The cost only depends on the size of fcn, not on the size of the whole database.
+		 * r2 must be locked by the caller.
+		 *
+		 * @param context everything else the result depends on, like the Sleigh ID and the print config
+		 * @param full also include comments inside of fcn and r2's types
+		 */
+		static std::string computeKey(RCore *core, RAnalFunction *fcn, const std::string &context, bool full = true);
+
+		/**
+		 * @return the cached code or nullptr if there is no valid entry for key
+		 */
+		static RAnnotatedCode *load(const std::string &dir, const std::string &key);
+
+		static bool store(const std::string &dir, const std::string &key, RAnnotatedCode *code);
+};
+
+/**
+ * Take ownership of code, which may be nullptr
+ */
+static inline std::shared_ptr<RAnnotatedCode> AnnotatedCodePtr(RAnnotatedCode *code)
+{
+	return std::shared_ptr<RAnnotatedCode>(code, r_annotated_code_free);
+}
+
+/**
+ * In-process LRU of decompiled functions
+ *
+ * Entries are looked up by the key from DecompileCache::computeKey() without the full flag,
+ * changes of comments and types are detected through r2's events and an sdb hook instead,
+ * which invalidate all entries by bumping a generation counter.
+ */
+
+class DecompileMemoryCache
+{
+	private:
+		struct Entry
+		{
+			std::string key;
+			ut64 generation;
+			std::shared_ptr<RAnnotatedCode> code;
+		};
+
+		std::mutex mutex;
+		std::list<Entry> entries; // most recently used first
+		size_t capacity = 0;
+		std::atomic<ut64> generation { 0 };
+
+		RCore *core = nullptr;
+		REventCallbackHandle event_handle;
+
+		static void EventCb(REvent *ev, int type, void *user, void *data);
+		static int TypesHookCb(void *s, void *user, const char *k, const char *v);
+
+		void trim();
+
+	public:
+		~DecompileMemoryCache();
+
+		void setCapacity(size_t capacity);
+
+		/**
+		 * @return the cached code or an empty pointer, stays valid when the entry is evicted
+		 */
+		std::shared_ptr<RAnnotatedCode> get(const std::string &key);
+
+		/**
+		 * @param generation result of getGeneration() from before the key was computed
+		 */
+		void put(const std::string &key, const std::shared_ptr<RAnnotatedCode> &code, ut64 generation);
+
+		ut64 getGeneration() const	{ return generation; }
+
+		void clear();
+
+		void hook(RCore *core);
+		void unhook();
+};
+
+#endif //R2GHIDRA_DECOMPILECACHE_H
@@ -0,0 +1,106 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#include "DecompileProfile.h"
+
+#include <r_cons.h>
+#include <r_util.h>
+
+const char *DecompileProfile::phaseName(Phase phase)
+{
+	switch(phase)
+	{
+		case ARCH_INIT:
+			return "arch_init";
+		case TRANSLATOR_BUILD:
+			return "translator_build";
+		case SCOPE_QUERY:
+			return "scope_query";
+		case LOAD_IMAGE:
+			return "load_image";
+		case PERFORM:
+			return "perform";
+		case PRINT:
+			return "print";
+		case RENDER:
+			return "render";
+		default:
+			return "unknown";
+	}
+}
+
+bool DecompileProfile::isNested(Phase phase)
+{
+	switch(phase)
+	{
+		case TRANSLATOR_BUILD: // during arch_init
+		case SCOPE_QUERY: // during arch_init, perform and print
+		case LOAD_IMAGE:
+			return true;
+		default:
+			return false;
+	}
+}
+
+ut64 DecompileProfile::totalNs() const
+{
+	ut64 total = 0;
+	for(int i = 0; i < PHASE_COUNT; i++)
+	{
+		if(!isNested((Phase)i))
+			total += ns[i];
+	}
+	return total;
+}
+
+void DecompileProfile::printTable() const
+{
+	r_cons_printf("%-18s %10s %12s\n", "phase", "count", "ms");
+	for(int i = 0; i < PHASE_COUNT; i++)
+	{
+		if(!isNested((Phase)i))
+			r_cons_printf("%-18s %10" PFMT64u " %12.3f\n", phaseName((Phase)i), count[i], ns[i] / 1e6);
+	}
+	r_cons_printf("%-18s %10s %12.3f\n", "total", "", totalNs() / 1e6);
+	for(int i = 0; i < PHASE_COUNT; i++)
+	{
+		if(isNested((Phase)i))
+			r_cons_printf("  %-16s %10" PFMT64u " %12.3f (included above)\n", phaseName((Phase)i), count[i], ns[i] / 1e6);
+	}
+	r_cons_printf("\n");
+	r_cons_printf("%-18s %10" PFMT64u "\n", "load_image_bytes", load_image_bytes);
+	r_cons_printf("%-18s %10" PFMT64u "\n", "page_cache_hits", load_image_cache_hits);
+	r_cons_printf("%-18s %10" PFMT64u "\n", "page_cache_misses", load_image_cache_misses);
+	r_cons_printf("%-18s %10" PFMT64u "\n", "core_locks", core_locks);
+	r_cons_printf("%-18s %10" PFMT64u "\n", "scope_neg_hits", scope_negative_hits);
+	r_cons_printf("%-18s %10" PFMT64u "\n", "scope_neg_misses", scope_negative_misses);
+}
+
+void DecompileProfile::printJson() const
+{
+	PJ *pj = pj_new();
+	if(!pj)
+		return;
+	pj_o(pj);
+	pj_k(pj, "phases");
+	pj_o(pj);
+	for(int i = 0; i < PHASE_COUNT; i++)
+	{
+		pj_k(pj, phaseName((Phase)i));
+		pj_o(pj);
+		pj_kn(pj, "count", count[i]);
+		pj_kn(pj, "ns", ns[i]);
+		pj_kb(pj, "nested", isNested((Phase)i));
+		pj_end(pj);
+	}
+	pj_end(pj);
+	pj_kn(pj, "total_ns", totalNs());
+	pj_kn(pj, "load_image_bytes", load_image_bytes);
+	pj_kn(pj, "page_cache_hits", load_image_cache_hits);
+	pj_kn(pj, "page_cache_misses", load_image_cache_misses);
+	pj_kn(pj, "core_locks", core_locks);
+	pj_kn(pj, "scope_neg_hits", scope_negative_hits);
+	pj_kn(pj, "scope_neg_misses", scope_negative_misses);
+	pj_end(pj);
+	r_cons_printf("%s\n", pj_string(pj));
+	pj_free(pj);
+}
@@ -0,0 +1,81 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#ifndef R2GHIDRA_DECOMPILEPROFILE_H
+#define R2GHIDRA_DECOMPILEPROFILE_H
+
+#include <r_types.h>
+
+#include <chrono>
+
+/**
+ * Counts and accumulated wall-clock time per phase of a single decompilation, as printed by pdgT
+ */
+class DecompileProfile
+{
+	public:
+		enum Phase
+		{
+			ARCH_INIT,
+			TRANSLATOR_BUILD,
+			SCOPE_QUERY,
+			LOAD_IMAGE,
+			PERFORM,
+			PRINT,
+			RENDER,
+			PHASE_COUNT
+		};
+
+		static const char *phaseName(Phase phase);
+
+		/**
+		 * @return whether phase is only timed inside of other phases and must not be added to the total
+		 */
+		static bool isNested(Phase phase);
+
+		ut64 count[PHASE_COUNT] = {};
+		ut64 ns[PHASE_COUNT] = {};
+
+		ut64 load_image_bytes = 0;
+		ut64 load_image_cache_hits = 0;
+		ut64 load_image_cache_misses = 0;
+		ut64 core_locks = 0;
+		ut64 scope_negative_hits = 0;
+		ut64 scope_negative_misses = 0;
+
+		/**
+		 * @return sum of all phases that are not nested
+		 */
+		ut64 totalNs() const;
+
+		void printTable() const;
+		void printJson() const;
+};
+
+/**
+ * Adds the time until it goes out of scope to a phase, does nothing if profile is nullptr
+ */
+class ProfileTimer
+{
+	private:
+		DecompileProfile *const profile;
+		const DecompileProfile::Phase phase;
+		std::chrono::steady_clock::time_point start;
+
+	public:
+		ProfileTimer(DecompileProfile *profile, DecompileProfile::Phase phase)
+			: profile(profile), phase(phase)
+		{
+			if(profile)
+				start = std::chrono::steady_clock::now();
+		}
+
+		~ProfileTimer()
+		{
+			if(!profile)
+				return;
+			profile->count[phase]++;
+			profile->ns[phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		}
+};
+
+#endif //R2GHIDRA_DECOMPILEPROFILE_H
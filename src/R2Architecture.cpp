@@ -7,12 +7,17 @@
 #include "R2CommentDatabase.h"
 #include "R2Utils.h"
 #include "ArchMap.h"
+#include "SpecCache.h"
+#include "R2Snapshot.h"
+#include "DecompileProfile.h"
 
 #include <funcdata.hh>
 #include <coreaction.hh>
 
 #include <iostream>
 #include <cassert>
+#include <algorithm>
+#include <mutex>
 
 // maps radare2 calling conventions to decompiler proto models
 static const std::map<std::string, std::string> cc_map = {
@@ -28,6 +33,17 @@ static const std::map<std::string, std::string> cc_map = {
 		{ "arm16", "__stdcall" } /* not actually __stdcall */
 };
 
+// groups of the "decompile" action that the fast profile leaves out, only affecting the quality of the output
+static const char * const fast_removed_groups[] = {
+		"typerecovery", // iterative type propagation and pointer arithmetic recovery
+		"subvar", // sub-variable flow, splitting variables by the bits in use
+		"doubleload",
+		"doubleprecis", // joining of values split over two registers
+		"floatprecision",
+		"conditionalexe", // cleanup of conditionally executed instructions
+		"nodejoin" // joining of conditions split over several blocks when structuring
+};
+
 std::string FilenameFromCore(RCore *core)
 {
 	if(core && core->bin && core->bin->file)
@@ -35,10 +51,38 @@ std::string FilenameFromCore(RCore *core)
 	return std::string();
 }
 
-R2Architecture::R2Architecture(RCore *core, const std::string &sleigh_id)
-	: SleighArchitecture(FilenameFromCore(core), sleigh_id.empty() ? SleighIdFromCore(core) : sleigh_id, &cout),
-	coreMutex(core)
+R2Architecture::R2Architecture(RCore *core, const std::string &sleigh_id, std::recursive_mutex *core_access)
+	: R2Architecture(core, sleigh_id, FilenameFromCore(core), core_access)
+{
+}
+
+R2Architecture::R2Architecture(RCore *core, const std::string &sleigh_id, const std::string &filename, std::recursive_mutex *core_access)
+	: SleighArchitecture(filename, sleigh_id.empty() ? SleighIdFromCore(core) : sleigh_id, &cout),
+	coreMutex(core, core_access)
+{
+}
+
+// held for the whole Architecture::init, also by the pdga workers
+static std::mutex init_mutex;
+
+void R2Architecture::init(DocumentStorage &store)
+{
+	std::unique_lock<std::mutex> lock(init_mutex, std::try_to_lock);
+	if(!lock.owns_lock())
+	{
+		// the holder might need to access r2 while we wait
+		coreMutex.sleepBegin();
+		lock.lock();
+		coreMutex.sleepEnd();
+	}
+	SleighArchitecture::init(store);
+}
+
+R2Architecture::~R2Architecture()
 {
+	// SleighArchitecture never deletes the translator because it normally shares it, but ours is private
+	delete translate;
+	translate = nullptr;
 }
 
 ProtoModel *R2Architecture::protoModelFromR2CC(const char *cc)
@@ -67,11 +111,12 @@ static std::string lowercase(std::string str)
 
 void R2Architecture::loadRegisters(const Translate *translate)
 {
-	registers = {};
+	registers.clear();
 	if(!translate)
 		return;
 	std::map<VarnodeData, std::string> regs;
 	translate->getAllRegisters(regs);
+	registers.reserve(regs.size() * 2);
 	for(const auto &reg : regs)
 	{
 		registers[reg.second] = reg.first;
@@ -85,7 +130,6 @@ void R2Architecture::loadRegisters(const Translate *translate)
 
 Address R2Architecture::registerAddressFromR2Reg(const char *regname)
 {
-	loadRegisters(translate);
 	auto it = registers.find(regname);
 	if(it == registers.end())
 		it = registers.find(lowercase(regname));
@@ -94,11 +138,47 @@ Address R2Architecture::registerAddressFromR2Reg(const char *regname)
 	return it->second.getAddr();
 }
 
+void R2Architecture::buildSpecFile(DocumentStorage &store)
+{
+	// Same as SleighArchitecture::buildSpecFile, but the documents come from the process-wide SpecCache
+	std::string baseid = archid.substr(0, archid.rfind(':'));
+	std::string compiler = archid.substr(archid.rfind(':') + 1);
+
+	const auto &descriptions = getLanguageDescriptions();
+	auto language = std::find_if(descriptions.begin(), descriptions.end(), [&baseid](const LanguageDescription &desc) {
+		return desc.getId() == baseid;
+	});
+	if(language == descriptions.end())
+		throw LowlevelError("No sleigh specification for " + baseid);
+	const CompilerTag &compilertag = language->getCompiler(compiler);
+
+	std::string processorfile;
+	std::string compilerfile;
+	std::string slafile;
+	specpaths.findFile(processorfile, language->getProcessorSpec());
+	specpaths.findFile(compilerfile, compilertag.getSpec());
+	specpaths.findFile(slafile, language->getSlaFile());
+
+	store.registerTag(SpecCache::getRoot(processorfile));
+	store.registerTag(SpecCache::getRoot(compilerfile));
+	store.registerTag(SpecCache::getRoot(slafile));
+}
+
 Translate *R2Architecture::buildTranslator(DocumentStorage &store)
 {
-	Translate *ret = SleighArchitecture::buildTranslator(store);
-	loadRegisters(ret);
-	return ret;
+	// SleighArchitecture::buildTranslator would hand out one Sleigh instance per language to all architectures,
+	// which breaks as soon as two of them decompile concurrently, so every R2Architecture gets its own.
+	// Architecture::restoreFromSpec initializes it right after this.
+	return new Sleigh(loader, context);
+}
+
+void R2Architecture::restoreFromSpec(DocumentStorage &store)
+{
+	{
+		ProfileTimer timer(profile, DecompileProfile::TRANSLATOR_BUILD);
+		SleighArchitecture::restoreFromSpec(store);
+	}
+	loadRegisters(translate);
 }
 
 ContextDatabase *R2Architecture::getContextDatabase()
@@ -106,19 +186,23 @@ ContextDatabase *R2Architecture::getContextDatabase()
 	return context;
 }
 
-void R2Architecture::postSpecFile()
+void R2Architecture::setContextVariable(const std::string &name, const Address &addr, uintm value)
 {
-	RCoreLock core(getCore());
-	r_list_foreach_cpp<RAnalFunction>(core->anal->fcns, [&](RAnalFunction *func) {
-		if (func->is_noreturn)
-		{
-			// Configure noreturn functions
-			Funcdata *infd = symboltab->getGlobalScope()->queryFunction(Address(getDefaultCodeSpace(), func->addr));
-			if(!infd)
-				return;
-			infd->getFuncProto().setNoReturn(true);
-		}
-	});
+	context->setVariable(name, addr, value);
+	contextVariables.insert(name);
+}
+
+void R2Architecture::resetFunctionState()
+{
+	symboltab->getGlobalScope()->clear();
+	r2TypeFactory->refresh();
+	commentdb->clear();
+	r2LoadImage->clearCache(); // memory might have been written since the last function
+	stringManager->clear(); // same for the string literals decoded from it
+	for(const auto &name : contextVariables)
+		context->setVariableRegion(name, Address(getDefaultCodeSpace(), 0), Address(), 0);
+	contextVariables.clear();
+	warnings.clear();
 }
 
 void R2Architecture::buildAction(DocumentStorage &store)
@@ -127,14 +211,23 @@ void R2Architecture::buildAction(DocumentStorage &store)
 	universal_action(this);
 	if(rawptr)
 		allacts.removeFromGroup("decompile", "fixateglobals"); // this action (ActionMapGlobals) will create these ugly uRam0x12345s
-	allacts.setCurrent("decompile");
+	if(fast)
+	{
+		allacts.cloneGroup("decompile", "r2ghidra-fast");
+		for(const char *group : fast_removed_groups)
+			allacts.removeFromGroup("r2ghidra-fast", group);
+		allacts.setCurrent("r2ghidra-fast");
+	}
+	else
+		allacts.setCurrent("decompile");
+	ActionBudget::install(allacts.getCurrent(), &budget);
 }
 
 void R2Architecture::buildLoader(DocumentStorage &store)
 {
 	RCoreLock core(getCore());
 	collectSpecFiles(*errorstream);
-	loader = new R2LoadImage(getCore());
+	loader = r2LoadImage = new R2LoadImage(this);
 }
 
 Scope *R2Architecture::buildGlobalScope()
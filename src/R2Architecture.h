@@ -7,46 +7,117 @@
 #include "sleigh_arch.hh"
 
 #include "RCoreMutex.h"
+#include "DecompileBudget.h"
+
+#include <set>
+#include <unordered_map>
 
 class R2TypeFactory;
+class R2LoadImage;
+class DecompileProfile;
+class R2Snapshot;
 typedef struct r_core_t RCore;
 
+/**
+ * @return path of the file currently opened in r2's RBin, or empty
+ */
+std::string FilenameFromCore(RCore *core);
+
 class R2Architecture : public SleighArchitecture
 {
 	private:
 		RCoreMutex coreMutex;
 
 		R2TypeFactory *r2TypeFactory = nullptr;
-		std::map<std::string, VarnodeData> registers;
+		R2LoadImage *r2LoadImage = nullptr;
+		const R2Snapshot *snapshot = nullptr;
+		DecompileProfile *profile = nullptr;
+		std::unordered_map<std::string, VarnodeData> registers; // built once per translator, also holds lowercase names
 		std::vector<std::string> warnings;
+		std::set<std::string> contextVariables; // set through setContextVariable() since the last resetFunctionState()
+		DecompileBudget budget;
 
 		bool rawptr = false;
+		bool fast = false;
 
 		void loadRegisters(const Translate *translate);
 
 	public:
-		explicit R2Architecture(RCore *core, const std::string &sleigh_id);
+		/**
+		 * @param core_access if not null, all accesses to core are serialized through this mutex
+		 *                    instead of the r2 task sleep state, for use in worker threads
+		 */
+		explicit R2Architecture(RCore *core, const std::string &sleigh_id, std::recursive_mutex *core_access = nullptr);
+
+		/**
+		 * @param filename as returned by FilenameFromCore(), for constructing outside of the r2 task
+		 */
+		R2Architecture(RCore *core, const std::string &sleigh_id, const std::string &filename, std::recursive_mutex *core_access);
+		~R2Architecture() override;
 
 		RCoreMutex *getCore() { return &coreMutex; }
 
 		R2TypeFactory *getTypeFactory() const { return r2TypeFactory; }
+		R2LoadImage *getLoadImage() const { return r2LoadImage; }
 
 		ProtoModel *protoModelFromR2CC(const char *cc);
 		Address registerAddressFromR2Reg(const char *regname);
 
 		void addWarning(const std::string &warning)	{ warnings.push_back(warning); }
-		const std::vector<std::string> getWarnings() const { return warnings; }
+		const std::vector<std::string> &getWarnings() const { return warnings; }
 		ContextDatabase *getContextDatabase();
 
+		/**
+		 * Set a context variable like TMode from r2's analysis, it is reset to 0 by resetFunctionState()
+		 */
+		void setContextVariable(const std::string &name, const Address &addr, uintm value);
+
 		void setRawPtr(bool rawptr) { this->rawptr = rawptr; }
 
+		/**
+		 * If set before init(), decompile with a reduced action group
+		 * that skips type propagation and several simplification and cleanup passes
+		 */
+		void setFast(bool fast) { this->fast = fast; }
+
+		/**
+		 * If set, all r2 data is read from the snapshot instead of querying r2 directly.
+		 * The snapshot must outlive its use by this architecture.
+		 */
+		void setSnapshot(const R2Snapshot *snapshot) { this->snapshot = snapshot; }
+		const R2Snapshot *getSnapshot() const { return snapshot; }
+
+		/**
+		 * If set, timings and counters of the following decompilation are recorded into profile
+		 */
+		void setProfile(DecompileProfile *profile) { this->profile = profile; }
+		DecompileProfile *getProfile() const { return profile; }
+
+		/**
+		 * Limits checked while the current action runs, set them before each decompilation
+		 */
+		DecompileBudget &getBudget() { return budget; }
+
+		/**
+		 * Same as Architecture::init, but serialized with all other inits in the process,
+		 * as Ghidra's xml and p-code parsers used for the specs are not reentrant.
+		 */
+		void init(DocumentStorage &store);
+
+		/**
+		 * Drop everything that was queried from r2 for a previous decompilation
+		 * (scope cache, comments, string literals, context variables, warnings), keeping translator, types and actions.
+		 */
+		void resetFunctionState();
+
 	protected:
+		void buildSpecFile(DocumentStorage &store) override;
 		Translate *buildTranslator(DocumentStorage &store) override;
+		void restoreFromSpec(DocumentStorage &store) override;
 		void buildLoader(DocumentStorage &store) override;
 		Scope *buildGlobalScope() override;
 		void buildTypegrp(DocumentStorage &store) override;
 		void buildCommentDB(DocumentStorage &store) override;
-		void postSpecFile() override;
 		void buildAction(DocumentStorage &store) override;
 };
 
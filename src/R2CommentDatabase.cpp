@@ -2,19 +2,43 @@
 
 #include "R2CommentDatabase.h"
 #include "R2Architecture.h"
+#include "R2Snapshot.h"
 
 #include <r_core.h>
 
 #include "R2Utils.h"
 
+#include <algorithm>
+#include <vector>
+
 R2CommentDatabase::R2CommentDatabase(R2Architecture *arch)
-	: arch(arch),
-	cache_filled(false)
+	: arch(arch)
 {
 }
 
 void R2CommentDatabase::fillCache(const Address &fad) const
 {
+	if(filled_functions.find(fad) != filled_functions.end())
+		return;
+
+	const R2Snapshot *snapshot = arch->getSnapshot();
+	if(snapshot)
+	{
+		const R2Snapshot::Function *fcn = snapshot->getFunctionAt(fad.getOffset());
+		if(!fcn)
+			fcn = snapshot->getFunctionIn(fad.getOffset());
+		if(!fcn)
+			return;
+		const auto &comments = snapshot->getComments();
+		for(const auto &range : MergeRanges(fcn->ranges))
+		{
+			for(auto it = comments.lower_bound(range.first); it != comments.end() && it->first < range.second; it++)
+				cache.addComment(Comment::user2, fad, Address(arch->getDefaultCodeSpace(), it->first), it->second);
+		}
+		filled_functions.insert(fad);
+		return;
+	}
+
 	RCoreLock core(arch->getCore());
 
 	RAnalFunction *fcn = r_anal_get_function_at(core->anal, fad.getOffset());
@@ -28,21 +52,34 @@ void R2CommentDatabase::fillCache(const Address &fad) const
 	if(!fcn)
 		return;
 
-	r_interval_tree_foreach_cpp<RAnalMetaItem>(&core->anal->meta, [fad, fcn, this](RIntervalNode *node, RAnalMetaItem *meta) {
-		if(!meta || meta->type != R_META_TYPE_COMMENT || !meta->str)
-			return;
-		if(!r_anal_function_contains(fcn, node->start))
-			return;
-		cache.addComment(Comment::user2, fad, Address(arch->getDefaultCodeSpace(), node->start), meta->str);
+	std::vector<std::pair<ut64, ut64>> ranges;
+	r_list_foreach_cpp<RAnalBlock>(fcn->bbs, [&](RAnalBlock *bb) {
+		ranges.push_back({ bb->addr, bb->addr + bb->size });
 	});
+	for(const auto &range : MergeRanges(ranges))
+	{
+		RPVector *nodes = r_meta_get_all_intersect(core->anal, range.first, range.second - range.first, R_META_TYPE_COMMENT);
+		if(!nodes)
+			continue;
+		for(size_t i = 0; i < r_pvector_len(nodes); i++)
+		{
+			auto node = reinterpret_cast<RIntervalNode *>(r_pvector_at(nodes, i));
+			auto meta = reinterpret_cast<RAnalMetaItem *>(node->data);
+			// only comments starting inside of the function, not those that just overlap it
+			if(!meta || !meta->str || node->start < range.first)
+				continue;
+			cache.addComment(Comment::user2, fad, Address(arch->getDefaultCodeSpace(), node->start), meta->str);
+		}
+		r_pvector_free(nodes);
+	}
 
-	cache_filled = true;
+	filled_functions.insert(fad);
 }
 
 void R2CommentDatabase::clear()
 {
 	cache.clear();
-	cache_filled = false;
+	filled_functions.clear();
 }
 
 void R2CommentDatabase::clearType(const Address &fad, uint4 tp)
@@ -5,13 +5,15 @@
 
 #include <comment.hh>
 
+#include <set>
+
 class R2Architecture;
 
 class R2CommentDatabase : public CommentDatabase
 {
 		R2Architecture *arch;
 		mutable CommentDatabaseInternal cache;
-		mutable bool cache_filled;
+		mutable std::set<Address> filled_functions; // entrypoints of the functions whose comments are in cache
 		void fillCache(const Address &fad) const;
 
 	public:
@@ -2,17 +2,130 @@
 
 #include "R2LoadImage.h"
 #include "R2Architecture.h"
+#include "R2Snapshot.h"
+#include "DecompileProfile.h"
 
-R2LoadImage::R2LoadImage(RCoreMutex *coreMutex)
+#include "R2Utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+R2LoadImage::R2LoadImage(R2Architecture *arch)
 	: LoadImage("radare2_program"),
-	coreMutex(coreMutex)
+	arch(arch)
 {
 }
 
+void R2LoadImage::readPages(ut64 first_page, ut64 last_page)
+{
+	// read consecutive missing pages with a single io call
+	RCoreLock core(arch->getCore());
+	ut64 page = first_page;
+	while(page <= last_page)
+	{
+		if(pages.find(page) != pages.end())
+		{
+			page++;
+			continue;
+		}
+		ut64 run_end = page;
+		while(run_end < last_page && pages.find(run_end + 1) == pages.end())
+			run_end++;
+
+		std::vector<ut8> buf((run_end - page + 1) * cache_page_size);
+		r_io_read_at(core->io, page * cache_page_size, buf.data(), (int)buf.size());
+		for(ut64 p = page; p <= run_end; p++)
+		{
+			auto begin = buf.begin() + (p - page) * cache_page_size;
+			pages[p] = std::vector<ut8>(begin, begin + cache_page_size);
+		}
+		page = run_end + 1;
+	}
+}
+
 void R2LoadImage::loadFill(uint1 *ptr, int4 size, const Address &addr)
 {
-	RCoreLock core(coreMutex);
-	r_io_read_at(core->io, addr.getOffset(), ptr, size);
+	DecompileProfile *profile = arch->getProfile();
+	ProfileTimer timer(profile, DecompileProfile::LOAD_IMAGE);
+	if(profile && size > 0)
+		profile->load_image_bytes += size;
+
+	const R2Snapshot *snapshot = arch->getSnapshot();
+	if(snapshot && size >= 0 && snapshot->readMemory(addr.getOffset(), ptr, (size_t)size))
+		return;
+	if(size <= 0)
+		return;
+
+	ut64 offset = addr.getOffset();
+	ut64 first_page = offset / cache_page_size;
+	ut64 last_page = (offset + size - 1) / cache_page_size;
+	if(last_page < first_page) // wraps around the address space
+	{
+		RCoreLock core(arch->getCore());
+		r_io_read_at(core->io, offset, ptr, size);
+		return;
+	}
+
+	bool hit = true;
+	for(ut64 page = first_page; page <= last_page; page++)
+	{
+		if(pages.find(page) == pages.end())
+		{
+			hit = false;
+			break;
+		}
+	}
+	if(hit)
+		cache_hits++;
+	else
+	{
+		cache_misses++;
+		readPages(first_page, last_page);
+	}
+
+	uint1 *out = ptr;
+	ut64 cur = offset;
+	ut64 end = offset + size;
+	while(cur < end)
+	{
+		const std::vector<ut8> &page = pages[cur / cache_page_size];
+		ut64 page_off = cur % cache_page_size;
+		ut64 len = std::min(end - cur, cache_page_size - page_off);
+		memcpy(out, page.data() + page_off, len);
+		out += len;
+		cur += len;
+	}
+}
+
+void R2LoadImage::prefetchFunction(ut64 addr)
+{
+	if(arch->getSnapshot())
+		return; // the snapshot already contains the bytes of all functions
+
+	std::vector<std::pair<ut64, ut64>> page_ranges;
+	{
+		RCoreLock core(arch->getCore());
+		RAnalFunction *fcn = r_anal_get_function_at(core->anal, addr);
+		if(!fcn)
+			return;
+		r_list_foreach_cpp<RAnalBlock>(fcn->bbs, [&](RAnalBlock *bb) {
+			if(!bb->size)
+				return;
+			// end exclusive, so adjacent pages are merged too
+			page_ranges.push_back({ bb->addr / cache_page_size, (bb->addr + bb->size - 1) / cache_page_size + 1 });
+		});
+	}
+
+	RCoreLock core(arch->getCore());
+	for(const auto &range : MergeRanges(std::move(page_ranges)))
+		readPages(range.first, range.second - 1);
+}
+
+void R2LoadImage::clearCache()
+{
+	pages.clear();
+	cache_hits = 0;
+	cache_misses = 0;
 }
 
 string R2LoadImage::getArchType() const
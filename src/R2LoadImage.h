@@ -7,24 +7,48 @@
 
 #include <r_core.h>
 
+#include <unordered_map>
+#include <vector>
+
 // Windows defines LoadImage to LoadImageA
 #ifdef LoadImage
 #undef LoadImage
 #endif
 
-class RCoreMutex;
+class R2Architecture;
 
 class R2LoadImage : public LoadImage
 {
 	private:
-		RCoreMutex *const coreMutex;
+		R2Architecture *const arch;
+
+		/**
+		 * Page-granular cache of everything read from r2's io,
+		 * valid until clearCache() is called, which happens for every decompiled function.
+		 */
+		std::unordered_map<ut64, std::vector<ut8>> pages;
+		ut64 cache_hits = 0;
+		ut64 cache_misses = 0;
+
+		void readPages(ut64 first_page, ut64 last_page);
 
 	public:
-		explicit R2LoadImage(RCoreMutex *coreMutex);
+		static const ut64 cache_page_size = 0x1000;
+
+		explicit R2LoadImage(R2Architecture *arch);
 
 		void loadFill(uint1 *ptr, int4 size, const Address &addr) override;
 		string getArchType() const override;
 		void adjustVma(long adjust) override;
+
+		/**
+		 * Read all pages covering the basic blocks of the function at addr in one batch
+		 */
+		void prefetchFunction(ut64 addr);
+
+		void clearCache();
+		ut64 getCacheHits() const	{ return cache_hits; }
+		ut64 getCacheMisses() const	{ return cache_misses; }
 };
 
 #endif //R2GHIDRA_R2LOADIMAGE_H
@@ -3,6 +3,8 @@
 #include "R2Scope.h"
 #include "R2Architecture.h"
 #include "R2TypeFactory.h"
+#include "R2Snapshot.h"
+#include "DecompileProfile.h"
 
 #include <funcdata.hh>
 
@@ -11,6 +13,9 @@
 
 #include "R2Utils.h"
 
+#include <algorithm>
+#include <vector>
+
 R2Scope::R2Scope(R2Architecture *arch)
 		: Scope("", arch),
 		  arch(arch),
@@ -23,6 +28,26 @@ R2Scope::~R2Scope()
 	delete cache;
 }
 
+void R2Scope::clear()
+{
+	cache->clear();
+	negativeCache.clear();
+	negativeHits = 0;
+	negativeMisses = 0;
+}
+
+bool R2Scope::isNegative(ut64 addr, NegativeKind kind) const
+{
+	auto it = negativeCache.find(addr);
+	if(it != negativeCache.end() && (it->second & kind))
+	{
+		negativeHits++;
+		return true;
+	}
+	negativeMisses++;
+	return false;
+}
+
 static std::string hex(ut64 v)
 {
 	std::stringstream ss;
@@ -48,109 +73,24 @@ static Element *childAddr(Element *el, const std::string &name, const Address &a
 	});
 }
 
-static Element *childType(Element *el, Datatype *type)
+FunctionSymbol *R2Scope::registerFunction(const R2Snapshot::Function &fcn) const
 {
-	auto pointer = dynamic_cast<TypePointer *>(type);
-	if(pointer)
-	{
-		Element *r = child(el, "type", {
-				{ "name", type->getName() },
-				{ "size", to_string(pointer->getSize()) },
-				{ "metatype", "ptr" }
-		});
-		childType(r, pointer->getPtrTo());
-		return r;
-	}
-
-	auto array = dynamic_cast<TypeArray *>(type);
-	if(array)
-	{
-		Element *r = child(el, "type", {
-				{ "name", "" },
-				{ "size", to_string(array->getSize()) },
-				{ "arraysize", to_string(array->numElements()) },
-				{ "metatype", "array" }
-		});
-		childType(r, array->getBase());
-		return nullptr;
-	}
-
-	return child(el, "typeref", {
-			{ "name", type->getName() },
-			{ "id", hex(type->getId()) }
-	});
-}
-
-static std::string to_string(const char *str)
-{
-	return std::string(str ? str : "(null)");
-}
-
-FunctionSymbol *R2Scope::registerFunction(RAnalFunction *fcn) const
-{
-	RCoreLock core(arch->getCore());
-
-	const std::string r2Arch(r_config_get(core->config, "asm.arch"));
-
-	// We use xml here, because the public interface for Functions
-	// doesn't let us set up the scope parenting as we need it :-(
-
-	Document doc;
-	doc.setName("mapsym");
-
-	if (fcn->bits == 16 && !r2Arch.compare("arm")) {
-		ContextDatabase * cdb = arch->getContextDatabase();
-		cdb->setVariable("TMode", Address(arch->getDefaultCodeSpace(), fcn->addr), 1);
-	}
-
-	const char *fcn_name = fcn->name;
-	if (core->flags->realnames) {
-		const RList *flags = r_flag_get_list(core->flags, fcn->addr);
-		if(flags)
-		{
-			RListIter *iter;
-			void *pos;
-			r_list_foreach(flags, iter, pos)
-			{
-				auto flag = reinterpret_cast<RFlagItem *>(pos);
-				if(flag->space && flag->space->name && !strcmp(flag->space->name, R_FLAGS_FS_SECTIONS))
-					continue;
-				if (flag->realname && *flag->realname) {
-					fcn_name = flag->realname;
-					break;
-				}
-			}
-		}
-	}
+	// The public interface for Functions doesn't let us set up the scope parenting as we need it,
+	// so the function and its local scope are created from a minimal xml shell.
+	// Everything inside of the scope is then added directly, only the prototype is still restored from xml.
 
-	auto functionElement = child(&doc, "function", {
-			{ "name", fcn_name },
-			{ "size", "1" }
-	});
+	if (fcn.thumb)
+		arch->setContextVariable("TMode", Address(arch->getDefaultCodeSpace(), fcn.addr), 1);
 
-	childAddr(functionElement, "addr", Address(arch->getDefaultCodeSpace(), fcn->addr));
+	const std::string &fcn_name = fcn.name;
 
-	auto localDbElement = child(functionElement, "localdb", {
-			{ "lock", "false" },
-			{ "main", "stack" }
-	});
-
-	auto scopeElement = child(localDbElement, "scope", {
-			{ "name", fcn_name }
-	});
-
-	child(child(scopeElement, "parent"), "val");
-	child(scopeElement, "rangelist");
-
-	auto symbollistElement = child(scopeElement, "symbollist");
-
-	ProtoModel *proto = fcn->cc ? arch->protoModelFromR2CC(fcn->cc) : nullptr;
+	ProtoModel *proto = !fcn.cc.empty() ? arch->protoModelFromR2CC(fcn.cc.c_str()) : nullptr;
 	if(!proto)
 	{
-		if(fcn->cc)
-			arch->addWarning("Matching calling convention " + to_string(fcn->cc) + " of function " + to_string(fcn_name) + " failed, args may be inaccurate.");
+		if(!fcn.cc.empty())
+			arch->addWarning("Matching calling convention " + fcn.cc + " of function " + fcn_name + " failed, args may be inaccurate.");
 		else
-			arch->addWarning("Function " + to_string(fcn_name) + " has no calling convention set, args may be inaccurate.");
+			arch->addWarning("Function " + fcn_name + " has no calling convention set, args may be inaccurate.");
 	}
 
 	int4 extraPop = proto ? proto->getExtraPop() : arch->translate->getDefaultSize();
@@ -158,16 +98,16 @@ FunctionSymbol *R2Scope::registerFunction(RAnalFunction *fcn) const
 		extraPop = arch->translate->getDefaultSize();
 
 	RangeList varRanges; // to check for overlaps
-	RList *vars = r_anal_var_all_list(core->anal, fcn);
+	const auto &vars = fcn.vars;
 	auto stackSpace = arch->getStackSpace();
 
-	auto addrForVar = [&](RAnalVar *var, bool warn_on_fail) {
-		switch(var->kind)
+	auto addrForVar = [&](const R2Snapshot::Var &var, bool warn_on_fail) {
+		switch(var.kind)
 		{
 			case R_ANAL_VAR_KIND_BPV:
 			{
 				uintb off;
-				int delta = var->delta - extraPop; // not 100% sure if extraPop is correct here
+				int delta = var.delta - extraPop; // not 100% sure if extraPop is correct here
 				if(delta >= 0)
 					off = delta;
 				else
@@ -176,98 +116,134 @@ FunctionSymbol *R2Scope::registerFunction(RAnalFunction *fcn) const
 			}
 			case R_ANAL_VAR_KIND_REG:
 			{
-				RRegItem *reg = r_reg_index_get(core->anal->reg, var->delta);
-				if(!reg)
+				if(var.regname.empty())
 				{
 					if(warn_on_fail)
-						arch->addWarning("Register for arg " + to_string(var->name) + " not found");
+						arch->addWarning("Register for arg " + var.name + " not found");
 					return Address();
 				}
 
-				auto ret = arch->registerAddressFromR2Reg(reg->name);
+				auto ret = arch->registerAddressFromR2Reg(var.regname.c_str());
 				if(ret.isInvalid() && warn_on_fail)
-					arch->addWarning("Failed to match register " + to_string(var->name) + " for arg " + to_string(var->name));
+					arch->addWarning("Failed to match register " + var.name + " for arg " + var.name);
 
 				return ret;
 			}
 			case R_ANAL_VAR_KIND_SPV:
 				if(warn_on_fail)
-					arch->addWarning("Var " + to_string(var->name) + " is stack pointer based, which is not supported for decompilation.");
+					arch->addWarning("Var " + var.name + " is stack pointer based, which is not supported for decompilation.");
 				return Address();
 			default:
 				if(warn_on_fail)
-					arch->addWarning("Failed to get address for var " + to_string(var->name));
+					arch->addWarning("Failed to get address for var " + var.name);
 				return Address();
 		}
 	};
 
-	std::map<RAnalVar *, Datatype *> var_types;
+	std::vector<Datatype *> var_types(vars.size(), nullptr);
 
 	ParamActive params(false);
 
-	if(vars)
+	for(size_t vi = 0; vi < vars.size(); vi++)
 	{
-		r_list_foreach_cpp<RAnalVar>(vars, [&](RAnalVar *var) {
-			std::string typeError;
-			Datatype *type = var->type ? arch->getTypeFactory()->fromCString(var->type, &typeError) : nullptr;
+		const auto &var = vars[vi];
+		std::string typeError;
+		Datatype *type = !var.type.empty() ? arch->getTypeFactory()->fromCString(var.type, &typeError) : nullptr;
+		if(!type)
+		{
+			arch->addWarning("Failed to match type " + (var.type.empty() ? std::string("(null)") : var.type) + " for variable " + var.name + " to Decompiler type: " + typeError);
+			type = arch->types->getBase(fcn.anal_bits / 8, TYPE_UNKNOWN);
 			if(!type)
-			{
-				arch->addWarning("Failed to match type " + to_string(var->type) + " for variable " + to_string(var->name) + " to Decompiler type: " + typeError);
-				type = arch->types->getBase(core->anal->bits / 8, TYPE_UNKNOWN);
-				if(!type)
-					return;
-			}
-			var_types[var] = type;
-
-			if(!var->isarg)
-				return;
-			auto addr = addrForVar(var, true);
-			if(addr.isInvalid())
-				return;
-			params.registerTrial(addr, type->getSize());
-			int4 i = params.whichTrial(addr, type->getSize());
-			params.getTrial(i).markActive();
-		});
+				continue;
+		}
+		var_types[vi] = type;
+
+		if(!var.isarg)
+			continue;
+		auto addr = addrForVar(var, true);
+		if(addr.isInvalid())
+			continue;
+		params.registerTrial(addr, type->getSize());
+		int4 i = params.whichTrial(addr, type->getSize());
+		params.getTrial(i).markActive();
 	}
 
 	if(proto)
 		proto->deriveInputMap(&params);
 
-	auto childRegRange = [&](Element *e) {
-		// For reg args, add a range just before the function
-		// This prevents the arg to be assigned as a local variable in the decompiled function,
-		// which can make the code confusing to read.
-		// (Ghidra does the same)
-		Address rangeAddr(arch->getDefaultCodeSpace(), fcn->addr > 0 ? fcn->addr - 1 : 0);
-		child(e, "range", {
-				{ "space", rangeAddr.getSpace()->getName() },
-				{ "first", hex(rangeAddr.getOffset()) },
-				{ "last", hex(rangeAddr.getOffset()) }
-		});
+	Document doc;
+	doc.setName("mapsym");
+
+	auto functionElement = child(&doc, "function", {
+			{ "name", fcn_name },
+			{ "size", "1" }
+	});
+
+	childAddr(functionElement, "addr", Address(arch->getDefaultCodeSpace(), fcn.addr));
+
+	auto localDbElement = child(functionElement, "localdb", {
+			{ "lock", "false" },
+			{ "main", "stack" }
+	});
+
+	auto scopeElement = child(localDbElement, "scope", {
+			{ "name", fcn_name }
+	});
+
+	child(child(scopeElement, "parent"), "val");
+	child(scopeElement, "rangelist");
+	child(scopeElement, "symbollist");
+
+	child(&doc, "addr", {
+			{ "space", arch->getDefaultCodeSpace()->getName() },
+			{ "offset", hex(fcn.addr) }
+	});
+
+	child(&doc, "rangelist");
+
+	auto sym = dynamic_cast<FunctionSymbol *>(cache->addMapSym(&doc));
+	if(!sym)
+		return nullptr;
+	Funcdata *fd = sym->getFunction();
+	ScopeLocal *localScope = fd->getScopeLocal();
+
+	// For reg args, map them only at a point just before the function
+	// This prevents the arg to be assigned as a local variable in the decompiled function,
+	// which can make the code confusing to read.
+	// (Ghidra does the same)
+	Address regArgUsepoint(arch->getDefaultCodeSpace(), fcn.addr > 0 ? fcn.addr - 1 : 0);
+
+	auto addVarSymbol = [&](const std::string &name, Datatype *type, const Address &addr, bool typelock, int4 paramIndex, bool regRange) {
+		SymbolEntry *entry = localScope->addSymbol(name, type, addr, regRange ? regArgUsepoint : Address());
+		Symbol *varSym = entry->getSymbol();
+		localScope->setAttribute(varSym, typelock ? (Varnode::namelock | Varnode::typelock) : Varnode::namelock);
+		if(paramIndex >= 0)
+			localScope->setCategory(varSym, 0, paramIndex);
 	};
 
-	if(vars)
+	if(!vars.empty())
 	{
-		std::vector<Element *> argsByIndex;
+		std::vector<bool> argsByIndex;
 
-		r_list_foreach_cpp<RAnalVar>(vars, [&](RAnalVar *var) {
-			auto type_it = var_types.find(var);
-			if(type_it == var_types.end())
-				return;
-			Datatype *type = type_it->second;
+		for(size_t vi = 0; vi < vars.size(); vi++)
+		{
+			const auto &var = vars[vi];
+			Datatype *type = var_types[vi];
+			if(!type)
+				continue;
 			bool typelock = true;
 
-			auto addr = addrForVar(var, var->isarg /* Already emitted this warning before */);
+			auto addr = addrForVar(var, var.isarg /* Already emitted this warning before */);
 			if(addr.isInvalid())
-				return;
+				continue;
 
 			uintb last = addr.getOffset();
 			if(type->getSize() > 0)
 				last += type->getSize() - 1;
 			if(last < addr.getOffset())
 			{
-				arch->addWarning("Variable " + to_string(var->name) + " extends beyond the stackframe. Try changing its type to something smaller.");
-				return;
+				arch->addWarning("Variable " + var.name + " extends beyond the stackframe. Try changing its type to something smaller.");
+				continue;
 			}
 			bool overlap = false;
 			for(const auto &range : varRanges)
@@ -284,54 +260,42 @@ FunctionSymbol *R2Scope::registerFunction(RAnalFunction *fcn) const
 
 			if(overlap)
 			{
-				arch->addWarning("Detected overlap for variable " + to_string(var->name));
+				arch->addWarning("Detected overlap for variable " + var.name);
 
-				if(var->isarg) // Can't have args with typelock=false, otherwise we get segfaults in the Decompiler
-					return;
+				if(var.isarg) // Can't have args with typelock=false, otherwise we get segfaults in the Decompiler
+					continue;
 
 				typelock = false;
 			}
 
-			if(var->isarg && proto && !proto->possibleInputParam(addr, type->getSize()))
+			if(var.isarg && proto && !proto->possibleInputParam(addr, type->getSize()))
 			{
 				// Prevent segfaults in the Decompiler
-				arch->addWarning("Removing arg " + to_string(var->name) + " because it doesn't fit into ProtoModel");
-				return;
+				arch->addWarning("Removing arg " + var.name + " because it doesn't fit into ProtoModel");
+				continue;
 			}
 
 			varRanges.insertRange(addr.getSpace(), addr.getOffset(), last);
 
-			auto mapsymElement = child(symbollistElement, "mapsym");
-			auto symbolElement = child(mapsymElement, "symbol", {
-					{ "name", var->name },
-					{ "typelock", typelock ? "true" : "false" },
-					{ "namelock", "true" },
-					{ "readonly", "false" },
-					{ "cat", var->isarg ? "0" : "-1" }
-			});
-
-			if(var->isarg)
+			int4 paramIndex = -1;
+			if(var.isarg)
 			{
-				int4 paramIndex = params.whichTrial(addr, type->getSize());
+				paramIndex = params.whichTrial(addr, type->getSize());
 
 				if(paramIndex < 0)
-					arch->addWarning("Failed to determine arg index of " + to_string(var->name));
+				{
+					arch->addWarning("Failed to determine arg index of " + var.name);
+					paramIndex = 0;
+				}
 
 				if(argsByIndex.size() < paramIndex + 1)
-					argsByIndex.resize(paramIndex + 1, nullptr);
-
-				argsByIndex[paramIndex] = symbolElement;
+					argsByIndex.resize(paramIndex + 1, false);
 
-				symbolElement->addAttribute("index", to_string(paramIndex < 0 ? 0 : paramIndex));
+				argsByIndex[paramIndex] = true;
 			}
 
-			childType(symbolElement, type);
-			childAddr(mapsymElement, "addr", addr);
-
-			auto rangelist = child(mapsymElement, "rangelist");
-			if(var->isarg && var->kind == R_ANAL_VAR_KIND_REG)
-				childRegRange(rangelist);
-		});
+			addVarSymbol(var.name, type, addr, typelock, paramIndex, var.isarg && var.kind == R_ANAL_VAR_KIND_REG);
+		}
 
 		// Add placeholder args in gaps
 		for(size_t i=0; i<argsByIndex.size(); i++)
@@ -345,28 +309,14 @@ FunctionSymbol *R2Scope::registerFunction(RAnalFunction *fcn) const
 			if(!type)
 				continue;
 
-			auto mapsymElement = child(symbollistElement, "mapsym");
-			auto symbolElement = child(mapsymElement, "symbol", {
-					{ "name", "placeholder_" + to_string(i) },
-					{ "typelock", "true" },
-					{ "namelock", "true" },
-					{ "readonly", "false" },
-					{ "cat", "0" },
-					{ "index", to_string(i) }
-			});
-
-			childAddr(mapsymElement, "addr", trial.getAddress());
-			childType(symbolElement, type);
-
-			auto rangelist = child(mapsymElement, "rangelist");
-			if(trial.getAddress().getSpace() != arch->translate->getStackSpace())
-				childRegRange(rangelist);
+			addVarSymbol("placeholder_" + to_string(i), type, trial.getAddress(), true, (int4)i,
+					trial.getAddress().getSpace() != arch->translate->getStackSpace());
 		}
 	}
 
-	r_list_free(vars);
-
-	auto prototypeElement = child(functionElement, "prototype", {
+	// The prototype is restored only after the symbols exist, so its inputs are taken from the locked args
+	Document protoDoc;
+	auto prototypeElement = child(&protoDoc, "prototype", {
 			{ "extrapop", to_string(extraPop) },
 			{ "model", proto ? proto->getName() : "unknown" }
 	});
@@ -396,27 +346,23 @@ FunctionSymbol *R2Scope::registerFunction(RAnalFunction *fcn) const
 			{ "name", "undefined" }
 	});
 
-	child(&doc, "addr", {
-			{ "space", arch->getDefaultCodeSpace()->getName() },
-			{ "offset", hex(fcn->addr) }
-	});
-
-	child(&doc, "rangelist");
-
-	auto sym = cache->addMapSym(&doc);
-	return dynamic_cast<FunctionSymbol *>(sym);
+	// Funcdata::restoreXml only binds the prototype to the local scope if it sees a <prototype>,
+	// so this is done here just like it would, before the inputs are read from the scope.
+	fd->getFuncProto().setScope(localScope, Address(arch->getDefaultCodeSpace(), fcn.addr) + -1);
+	fd->getFuncProto().restoreXml(prototypeElement, arch);
+	if(fcn.noreturn)
+		fd->getFuncProto().setNoReturn(true);
+	return sym;
 }
 
-Symbol *R2Scope::registerFlag(RFlagItem *flag) const
+Symbol *R2Scope::registerFlag(const R2Snapshot::Flag &flag) const
 {
-	RCoreLock core(arch->getCore());
-
 	uint4 attr = Varnode::namelock | Varnode::typelock;
 	Datatype *type = nullptr;
-	if(flag->space && !strcmp(flag->space->name, R_FLAGS_FS_STRINGS))
+	if(flag.is_string)
 	{
 		Datatype *ptype = arch->types->findByName("char");
-		type = arch->types->getTypeArray(static_cast<int4>(flag->size), ptype);
+		type = arch->types->getTypeArray(static_cast<int4>(flag.size), ptype);
 		attr |= Varnode::readonly;
 	}
 
@@ -427,9 +373,7 @@ Symbol *R2Scope::registerFlag(RFlagItem *flag) const
 		type = arch->types->getTypeCode();
 	}
 
-	// Check whether flags should be displayed by their real name
-	const char *name = (core->flags->realnames && flag->realname) ? flag->realname : flag->name;
-	SymbolEntry *entry = cache->addSymbol(name, type, Address(arch->getDefaultCodeSpace(), flag->offset), Address());
+	SymbolEntry *entry = cache->addSymbol(flag.name, type, Address(arch->getDefaultCodeSpace(), flag.offset), Address());
 	if(!entry)
 		return nullptr;
 
@@ -439,46 +383,101 @@ Symbol *R2Scope::registerFlag(RFlagItem *flag) const
 	return symbol;
 }
 
-Symbol *R2Scope::queryR2Absolute(ut64 addr, bool contain) const
+const R2SymbolIndex &R2Scope::getSymbolIndex() const
 {
+	const R2Snapshot *snapshot = arch->getSnapshot();
+	if(snapshot)
+		return snapshot->getSymbolIndex();
+
 	RCoreLock core(arch->getCore());
+	// r2 has no events for added or removed functions and flags, but their counts are cheap to check
+	ut64 functions = r_list_length(core->anal->fcns);
+	ut64 flags = core->flags->ht_name->count;
+	if(symbolIndex && functions == symbolIndexFunctions && flags == symbolIndexFlags)
+		return *symbolIndex;
+
+	symbolIndex.reset(new R2SymbolIndex());
+	symbolIndexFunctions = functions;
+	symbolIndexFlags = flags;
+
+	r_list_foreach_cpp<RAnalFunction>(core->anal->fcns, [&](RAnalFunction *fcn) {
+		symbolIndex->add(fcn->addr, 1, R2SymbolIndex::Kind::FUNCTION);
+	});
 
-	RAnalFunction *fcn = r_anal_get_function_at(core->anal, addr);
-#if 0
-	// This can cause functions to be registered twice (hello-arm test)
-	if(!fcn && contain)
+	std::vector<ut64> offsets;
+	r_flag_foreach(core->flags, [](RFlagItem *flag, void *user) -> bool {
+		reinterpret_cast<std::vector<ut64> *>(user)->push_back(flag->offset);
+		return true;
+	}, &offsets);
+	std::sort(offsets.begin(), offsets.end());
+	offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+	for(ut64 offset : offsets)
 	{
-		RList *fcns = r_anal_get_functions_in(core->anal, addr);
-		if(!r_list_empty(fcns))
-			fcn = reinterpret_cast<RAnalFunction *>(r_list_first(fcns));
-		r_list_free(fcns);
+		RFlagItem *flag = R2Snapshot::symbolFlagAt(core, offset);
+		if(flag)
+			symbolIndex->add(offset, R2Snapshot::captureFlag(core, flag).symbolSize(), R2SymbolIndex::Kind::FLAG);
 	}
-#endif
-	if(fcn)
-		return registerFunction(fcn);
 
-	// TODO: register more things
+	symbolIndex->finish();
+	return *symbolIndex;
+}
 
-	// TODO: correctly handle contain for flags
-	const RList *flags = r_flag_get_list(core->flags, addr);
-	if(flags)
+Symbol *R2Scope::registerIndexEntry(const R2SymbolIndex::Entry &entry) const
+{
+	const R2Snapshot *snapshot = arch->getSnapshot();
+	if(snapshot)
 	{
-		RListIter *iter;
-		void *pos;
-		r_list_foreach(flags, iter, pos)
+		if(entry.kind == R2SymbolIndex::Kind::FUNCTION)
 		{
-			auto flag = reinterpret_cast<RFlagItem *>(pos);
-			if(flag->space && flag->space->name && !strcmp(flag->space->name, R_FLAGS_FS_SECTIONS))
-				continue;
-			return registerFlag(flag);
+			const R2Snapshot::Function *fcn = snapshot->getFunctionAt(entry.addr);
+			return fcn ? registerFunction(*fcn) : nullptr;
 		}
+		const R2Snapshot::Flag *flag = snapshot->getFlagAt(entry.addr);
+		return flag ? registerFlag(*flag) : nullptr;
 	}
-	return nullptr;
+
+	RCoreLock core(arch->getCore());
+	if(entry.kind == R2SymbolIndex::Kind::FUNCTION)
+	{
+		RAnalFunction *fcn = r_anal_get_function_at(core->anal, entry.addr);
+		return fcn ? registerFunction(R2Snapshot::captureFunction(core, fcn)) : nullptr;
+	}
+
+	// TODO: register more things
+
+	RFlagItem *flag = R2Snapshot::symbolFlagAt(core, entry.addr);
+	return flag ? registerFlag(R2Snapshot::captureFlag(core, flag)) : nullptr;
 }
 
+SymbolEntry *R2Scope::mapIndexEntry(const R2SymbolIndex::Entry *entry) const
+{
+	if(!entry)
+		return nullptr;
+	Address addr(arch->getDefaultCodeSpace(), entry->addr);
+	SymbolEntry *r = cache->findAddr(addr, Address());
+	if(r)
+		return r;
+	Symbol *sym = registerIndexEntry(*entry);
+	return sym ? sym->getMapEntry(addr) : nullptr;
+}
+
+Symbol *R2Scope::queryR2Absolute(ut64 addr, bool contain) const
+{
+	// Functions are only contained at their entrypoint, because their symbols have size 1.
+	// Matching anywhere inside of them would register functions twice (hello-arm test).
+	if(isNegative(addr, contain ? NEGATIVE_CONTAINING : NEGATIVE_AT))
+		return nullptr;
+	const R2SymbolIndex &index = getSymbolIndex();
+	const R2SymbolIndex::Entry *entry = contain ? index.findContaining(addr) : index.findAt(addr);
+	Symbol *sym = entry ? registerIndexEntry(*entry) : nullptr;
+	if(!sym) // nothing containing addr also means nothing at addr
+		addNegative(addr, contain ? (NEGATIVE_CONTAINING | NEGATIVE_AT) : NEGATIVE_AT);
+	return sym;
+}
 
 Symbol *R2Scope::queryR2(const Address &addr, bool contain) const
 {
+	ProfileTimer timer(arch->getProfile(), DecompileProfile::SCOPE_QUERY);
 	if(addr.getSpace() == arch->getDefaultCodeSpace() || addr.getSpace() == arch->getDefaultDataSpace())
 		return queryR2Absolute(addr.getOffset(), contain);
 	return nullptr;
@@ -486,6 +485,21 @@ Symbol *R2Scope::queryR2(const Address &addr, bool contain) const
 
 LabSymbol *R2Scope::queryR2FunctionLabel(const Address &addr) const
 {
+	if(isNegative(addr.getOffset(), NEGATIVE_LABEL))
+		return nullptr;
+	LabSymbol *sym = lookupR2FunctionLabel(addr);
+	if(!sym)
+		addNegative(addr.getOffset(), NEGATIVE_LABEL);
+	return sym;
+}
+
+LabSymbol *R2Scope::lookupR2FunctionLabel(const Address &addr) const
+{
+	const R2Snapshot *snapshot = arch->getSnapshot();
+	if(snapshot && !snapshot->getFunctionIn(addr.getOffset()))
+		return nullptr;
+
+	// labels are not part of the snapshot
 	RCoreLock core(arch->getCore());
 
 	RAnalFunction *fcn = r_anal_get_fcn_in(core->anal, addr.getOffset(), R_ANAL_FCN_TYPE_NULL);
@@ -536,6 +550,42 @@ SymbolEntry *R2Scope::findContainer(const Address &addr, int4 size, const Addres
 	return entry;
 }
 
+SymbolEntry *R2Scope::findOverlap(const Address &addr, int4 size) const
+{
+	SymbolEntry *entry = cache->findOverlap(addr, size);
+	if(addr.getSpace() != arch->getDefaultCodeSpace())
+		return entry;
+
+	const R2SymbolIndex::Entry *indexed = getSymbolIndex().findOverlap(addr.getOffset(), size);
+	if(indexed && (!entry || indexed->addr < entry->getAddr().getOffset()))
+		return mapIndexEntry(indexed);
+	return entry;
+}
+
+SymbolEntry *R2Scope::findBefore(const Address &addr) const
+{
+	SymbolEntry *entry = cache->findBefore(addr);
+	if(addr.getSpace() != arch->getDefaultCodeSpace())
+		return entry;
+
+	const R2SymbolIndex::Entry *indexed = getSymbolIndex().findBefore(addr.getOffset());
+	if(indexed && (!entry || indexed->addr > entry->getAddr().getOffset()))
+		return mapIndexEntry(indexed);
+	return entry;
+}
+
+SymbolEntry *R2Scope::findAfter(const Address &addr) const
+{
+	SymbolEntry *entry = cache->findAfter(addr);
+	if(addr.getSpace() != arch->getDefaultCodeSpace())
+		return entry;
+
+	const R2SymbolIndex::Entry *indexed = getSymbolIndex().findAfter(addr.getOffset());
+	if(indexed && (!entry || indexed->addr < entry->getAddr().getOffset()))
+		return mapIndexEntry(indexed);
+	return entry;
+}
+
 Funcdata *R2Scope::findFunction(const Address &addr) const
 {
 	Funcdata *fd = cache->findFunction(addr);
@@ -589,6 +639,10 @@ bool R2Scope::isNameUsed(const string &name) const
 	if(cache->isNameUsed(name))
 		return true;
 
+	const R2Snapshot *snapshot = arch->getSnapshot();
+	if(snapshot)
+		return snapshot->isNameUsed(name);
+
 	RCoreLock core(arch->getCore());
 	if (r_flag_get(core->flags, name.c_str()))
 		return true;
@@ -7,26 +7,49 @@
 
 #include <r_types.h>
 
+#include "R2Snapshot.h"
+
+#include <memory>
+#include <unordered_map>
+
 // Windows defines LoadImage to LoadImageA
 #ifdef LoadImage
 #undef LoadImage
 #endif
 
 class R2Architecture;
-typedef struct r_anal_function_t RAnalFunction;
-typedef struct r_flag_item_t RFlagItem;
 
 class R2Scope : public Scope
 {
 	private:
 		R2Architecture *arch;
 		ScopeInternal *cache;
+		mutable std::unique_ptr<R2SymbolIndex> symbolIndex; // only used without snapshot, kept across clear()
+		mutable ut64 symbolIndexFunctions = 0; // counts of functions and flags the index was built from
+		mutable ut64 symbolIndexFlags = 0;
+
+		enum NegativeKind : ut8
+		{
+			NEGATIVE_AT = 1 << 0,
+			NEGATIVE_CONTAINING = 1 << 1,
+			NEGATIVE_LABEL = 1 << 2
+		};
+		mutable std::unordered_map<ut64, ut8> negativeCache; // addresses r2 has nothing for, by kind of query
+		mutable ut64 negativeHits = 0;
+		mutable ut64 negativeMisses = 0;
 
-		FunctionSymbol *registerFunction(RAnalFunction *fcn) const;
-		Symbol *registerFlag(RFlagItem *flag) const;
+		bool isNegative(ut64 addr, NegativeKind kind) const;
+		void addNegative(ut64 addr, ut8 kinds) const	{ negativeCache[addr] |= kinds; }
+
+		const R2SymbolIndex &getSymbolIndex() const;
+		FunctionSymbol *registerFunction(const R2Snapshot::Function &fcn) const;
+		Symbol *registerFlag(const R2Snapshot::Flag &flag) const;
+		Symbol *registerIndexEntry(const R2SymbolIndex::Entry &entry) const;
+		SymbolEntry *mapIndexEntry(const R2SymbolIndex::Entry *entry) const;
 		Symbol *queryR2Absolute(ut64 addr, bool contain) const;
 		Symbol *queryR2(const Address &addr, bool contain) const;
 		LabSymbol *queryR2FunctionLabel(const Address &addr) const;
+		LabSymbol *lookupR2FunctionLabel(const Address &addr) const;
 
 	protected:
 		// TODO? void addRange(AddrSpace *spc,uintb first,uintb last) override;
@@ -39,7 +62,7 @@ class R2Scope : public Scope
 		explicit R2Scope(R2Architecture *arch);
 		~R2Scope() override;
 
-		void clear(void) override										{ cache->clear(); }
+		void clear(void) override;
 		SymbolEntry *addSymbol(const string &name, Datatype *ct, const Address &addr, const Address &usepoint) override	{ return cache->addSymbol(name, ct, addr, usepoint); }
 		string buildVariableName(const Address &addr, const Address &pc, Datatype *ct,int4 &index,uint4 flags) const override { return cache->buildVariableName(addr,pc,ct,index,flags); }
 		string buildUndefinedName(void) const override					{ return cache->buildUndefinedName(); }
@@ -56,9 +79,15 @@ class R2Scope : public Scope
 		bool isNameUsed(const string &name) const override;
 		Funcdata *resolveExternalRefFunction(ExternRefSymbol *sym) const;
 
-		SymbolEntry *findOverlap(const Address &addr,int4 size) const	{ throw LowlevelError("findOverlap unimplemented"); }
-		SymbolEntry *findBefore(const Address &addr) const				{ throw LowlevelError("findBefore unimplemented"); }
-		SymbolEntry *findAfter(const Address &addr) const				{ throw LowlevelError("findAfter unimplemented"); }
+		/**
+		 * Queries answered by the negative cache since the last clear() vs. those that had to be looked up
+		 */
+		ut64 getNegativeCacheHits() const	{ return negativeHits; }
+		ut64 getNegativeCacheMisses() const	{ return negativeMisses; }
+
+		SymbolEntry *findOverlap(const Address &addr,int4 size) const;
+		SymbolEntry *findBefore(const Address &addr) const;
+		SymbolEntry *findAfter(const Address &addr) const;
 		void findByName(const string &name,vector<Symbol *> &res) const	{ throw LowlevelError("findByName unimplemented"); }
 		MapIterator begin() const override								{ throw LowlevelError("begin unimplemented"); }
 		MapIterator end() const override								{ throw LowlevelError("end unimplemented"); }
@@ -0,0 +1,208 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#include "R2Snapshot.h"
+
+#include <r_core.h>
+
+#include "R2Utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+bool R2Snapshot::Function::contains(ut64 addr) const
+{
+	for(const auto &range : ranges)
+	{
+		if(addr >= range.first && addr < range.second)
+			return true;
+	}
+	return false;
+}
+
+R2Snapshot::Function R2Snapshot::captureFunction(RCore *core, RAnalFunction *fcn)
+{
+	Function r;
+	r.addr = fcn->addr;
+	r.name = fcn->name ? fcn->name : "";
+	if(core->flags->realnames)
+	{
+		const RList *flags = r_flag_get_list(core->flags, fcn->addr);
+		if(flags)
+		{
+			RListIter *iter;
+			void *pos;
+			r_list_foreach(flags, iter, pos)
+			{
+				auto flag = reinterpret_cast<RFlagItem *>(pos);
+				if(flag->space && flag->space->name && !strcmp(flag->space->name, R_FLAGS_FS_SECTIONS))
+					continue;
+				if (flag->realname && *flag->realname) {
+					r.name = flag->realname;
+					break;
+				}
+			}
+		}
+	}
+	r.cc = fcn->cc ? fcn->cc : "";
+	const char *r2Arch = r_config_get(core->config, "asm.arch");
+	r.thumb = fcn->bits == 16 && r2Arch && !strcmp(r2Arch, "arm");
+	r.noreturn = fcn->is_noreturn;
+	r.anal_bits = core->anal->bits;
+
+	RList *vars = r_anal_var_all_list(core->anal, fcn);
+	if(vars)
+	{
+		r_list_foreach_cpp<RAnalVar>(vars, [&](RAnalVar *var) {
+			Var v;
+			v.name = var->name ? var->name : "";
+			v.type = var->type ? var->type : "";
+			v.kind = var->kind;
+			v.delta = var->delta;
+			v.isarg = var->isarg;
+			if(var->kind == R_ANAL_VAR_KIND_REG)
+			{
+				RRegItem *reg = r_reg_index_get(core->anal->reg, var->delta);
+				if(reg && reg->name)
+					v.regname = reg->name;
+			}
+			r.vars.push_back(v);
+		});
+	}
+	r_list_free(vars);
+
+	r_list_foreach_cpp<RAnalBlock>(fcn->bbs, [&](RAnalBlock *bb) {
+		r.ranges.push_back({ bb->addr, bb->addr + bb->size });
+	});
+
+	return r;
+}
+
+R2Snapshot::Flag R2Snapshot::captureFlag(RCore *core, RFlagItem *flag)
+{
+	Flag r;
+	r.offset = flag->offset;
+	r.size = flag->size;
+	// Check whether flags should be displayed by their real name
+	r.name = (core->flags->realnames && flag->realname) ? flag->realname : flag->name;
+	r.is_string = flag->space && flag->space->name && !strcmp(flag->space->name, R_FLAGS_FS_STRINGS);
+	return r;
+}
+
+RFlagItem *R2Snapshot::symbolFlagAt(RCore *core, ut64 offset)
+{
+	const RList *flags = r_flag_get_list(core->flags, offset);
+	if(!flags)
+		return nullptr;
+	RListIter *iter;
+	void *pos;
+	r_list_foreach(flags, iter, pos)
+	{
+		auto flag = reinterpret_cast<RFlagItem *>(pos);
+		if(flag->space && flag->space->name && !strcmp(flag->space->name, R_FLAGS_FS_SECTIONS))
+			continue;
+		return flag;
+	}
+	return nullptr;
+}
+
+R2Snapshot::R2Snapshot(RCore *core)
+	: types(core->anal->sdb_types)
+{
+	std::vector<std::pair<ut64, ut64>> code_ranges;
+	r_list_foreach_cpp<RAnalFunction>(core->anal->fcns, [&](RAnalFunction *fcn) {
+		if(fcn->name)
+			names.insert(fcn->name);
+		const Function &function = functions.emplace(fcn->addr, captureFunction(core, fcn)).first->second;
+		for(const auto &range : function.ranges)
+		{
+			function_ranges.push_back({ range.first, range.second, &function });
+			function_range_max = std::max(function_range_max, range.second - range.first);
+			code_ranges.push_back(range);
+		}
+	});
+	std::sort(function_ranges.begin(), function_ranges.end(), [](const FunctionRange &a, const FunctionRange &b) {
+		return a.start < b.start;
+	});
+
+	struct FlagsCtx
+	{
+		std::unordered_set<std::string> *names;
+		std::vector<ut64> offsets;
+	} flags_ctx = { &names, {} };
+	r_flag_foreach(core->flags, [](RFlagItem *flag, void *user) -> bool {
+		auto ctx = reinterpret_cast<FlagsCtx *>(user);
+		if(flag->name)
+			ctx->names->insert(flag->name);
+		ctx->offsets.push_back(flag->offset);
+		return true;
+	}, &flags_ctx);
+	std::sort(flags_ctx.offsets.begin(), flags_ctx.offsets.end());
+	flags_ctx.offsets.erase(std::unique(flags_ctx.offsets.begin(), flags_ctx.offsets.end()), flags_ctx.offsets.end());
+	for(ut64 offset : flags_ctx.offsets)
+	{
+		RFlagItem *flag = symbolFlagAt(core, offset);
+		if(flag)
+			flags.emplace(offset, captureFlag(core, flag));
+	}
+
+	for(const auto &function : functions)
+		symbol_index.add(function.first, 1, R2SymbolIndex::Kind::FUNCTION);
+	for(const auto &flag : flags)
+		symbol_index.add(flag.first, flag.second.symbolSize(), R2SymbolIndex::Kind::FLAG);
+	symbol_index.finish();
+
+	r_interval_tree_foreach_cpp<RAnalMetaItem>(&core->anal->meta, [this](RIntervalNode *node, RAnalMetaItem *meta) {
+		if(!meta || meta->type != R_META_TYPE_COMMENT || !meta->str)
+			return;
+		comments.emplace(node->start, meta->str);
+	});
+
+	// bytes of all functions, with overlapping and adjacent blocks merged
+	for(const auto &range : MergeRanges(std::move(code_ranges)))
+	{
+		std::vector<ut8> &buf = memory[range.first];
+		buf.resize(range.second - range.first);
+		r_io_read_at(core->io, range.first, buf.data(), (int)buf.size());
+	}
+}
+
+const R2Snapshot::Function *R2Snapshot::getFunctionAt(ut64 addr) const
+{
+	auto it = functions.find(addr);
+	return it != functions.end() ? &it->second : nullptr;
+}
+
+const R2Snapshot::Function *R2Snapshot::getFunctionIn(ut64 addr) const
+{
+	auto it = std::upper_bound(function_ranges.begin(), function_ranges.end(), addr, [](ut64 addr, const FunctionRange &range) {
+		return addr < range.start;
+	});
+	while(it != function_ranges.begin())
+	{
+		it--;
+		if(addr < it->end)
+			return it->function;
+		if(addr - it->start >= function_range_max)
+			break;
+	}
+	return nullptr;
+}
+
+const R2Snapshot::Flag *R2Snapshot::getFlagAt(ut64 offset) const
+{
+	auto it = flags.find(offset);
+	return it != flags.end() ? &it->second : nullptr;
+}
+
+bool R2Snapshot::readMemory(ut64 addr, ut8 *ptr, size_t size) const
+{
+	auto it = memory.upper_bound(addr);
+	if(it == memory.begin())
+		return false;
+	it--;
+	ut64 offset = addr - it->first;
+	if(offset > it->second.size() || size > it->second.size() - offset)
+		return false;
+	memcpy(ptr, it->second.data() + offset, size);
+	return true;
+}
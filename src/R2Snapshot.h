@@ -0,0 +1,115 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#ifndef R2GHIDRA_R2SNAPSHOT_H
+#define R2GHIDRA_R2SNAPSHOT_H
+
+#include <r_types.h>
+
+#include "R2SymbolIndex.h"
+#include "R2TypeTable.h"
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+typedef struct r_core_t RCore;
+typedef struct r_anal_function_t RAnalFunction;
+typedef struct r_flag_item_t RFlagItem;
+
+/**
+ * Immutable copy of everything the decompiler reads from r2:
+ * functions with their vars, flags, types, comments and the bytes of all functions.
+ *
+ * Captured in one pass while r2 is locked, after that it can be queried from any thread without locking.
+ * The Function and Flag structs are also used on their own when querying r2 directly.
+ */
+class R2Snapshot
+{
+	public:
+		struct Var
+		{
+			std::string name;
+			std::string type;
+			std::string regname; // for R_ANAL_VAR_KIND_REG
+			int kind;
+			int delta;
+			bool isarg;
+		};
+
+		struct Function
+		{
+			ut64 addr;
+			std::string name; // already resolved to the flag's realname if r2 is configured to show those
+			std::string cc; // empty if not set
+			bool thumb;
+			bool noreturn;
+			int anal_bits;
+			std::vector<Var> vars;
+			std::vector<std::pair<ut64, ut64>> ranges; // basic blocks as [start, end)
+
+			bool contains(ut64 addr) const;
+		};
+
+		struct Flag
+		{
+			ut64 offset;
+			ut64 size;
+			std::string name; // already resolved to the realname if r2 is configured to show those
+			bool is_string;
+
+			/**
+			 * @return size of the symbol R2Scope registers for this flag
+			 */
+			ut64 symbolSize() const	{ return is_string && size ? size : 1; }
+		};
+
+		static Function captureFunction(RCore *core, RAnalFunction *fcn);
+		static Flag captureFlag(RCore *core, RFlagItem *flag);
+
+		/**
+		 * @return the first flag at offset that is not a section, which is what the decompiler should use as a symbol
+		 */
+		static RFlagItem *symbolFlagAt(RCore *core, ut64 offset);
+
+	private:
+		std::map<ut64, Function> functions;
+		struct FunctionRange
+		{
+			ut64 start;
+			ut64 end;
+			const Function *function;
+		};
+		std::vector<FunctionRange> function_ranges; // sorted by start
+		ut64 function_range_max = 0;
+		std::map<ut64, Flag> flags;
+		R2SymbolIndex symbol_index;
+		std::unordered_set<std::string> names;
+		R2TypeTable types;
+		std::multimap<ut64, std::string> comments;
+		std::map<ut64, std::vector<ut8>> memory;
+
+	public:
+		/**
+		 * Capture the current state of core, the caller must keep r2 locked while this runs
+		 */
+		explicit R2Snapshot(RCore *core);
+
+		const Function *getFunctionAt(ut64 addr) const;
+		const Function *getFunctionIn(ut64 addr) const;
+		const Flag *getFlagAt(ut64 offset) const;
+		const R2SymbolIndex &getSymbolIndex() const	{ return symbol_index; }
+		bool isNameUsed(const std::string &name) const	{ return names.find(name) != names.end(); }
+
+		const R2TypeTable &getTypes() const	{ return types; }
+
+		const std::multimap<ut64, std::string> &getComments() const	{ return comments; }
+
+		/**
+		 * @return true if the whole requested range is part of the snapshot
+		 */
+		bool readMemory(ut64 addr, ut8 *ptr, size_t size) const;
+};
+
+#endif //R2GHIDRA_R2SNAPSHOT_H
@@ -0,0 +1,74 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#include "R2SymbolIndex.h"
+
+#include <algorithm>
+
+void R2SymbolIndex::finish()
+{
+	std::stable_sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+		if(a.addr != b.addr)
+			return a.addr < b.addr;
+		return a.kind == Kind::FUNCTION && b.kind != Kind::FUNCTION;
+	});
+	entries.erase(std::unique(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+		return a.addr == b.addr;
+	}), entries.end());
+	entries.shrink_to_fit();
+
+	max_last.clear();
+	max_last.reserve(entries.size());
+	ut64 max = 0;
+	for(const auto &entry : entries)
+	{
+		max = std::max(max, entry.last());
+		max_last.push_back(max);
+	}
+}
+
+static bool AddrLess(const R2SymbolIndex::Entry &entry, ut64 addr)
+{
+	return entry.addr < addr;
+}
+
+const R2SymbolIndex::Entry *R2SymbolIndex::findAt(ut64 addr) const
+{
+	auto it = std::lower_bound(entries.begin(), entries.end(), addr, AddrLess);
+	return it != entries.end() && it->addr == addr ? &*it : nullptr;
+}
+
+const R2SymbolIndex::Entry *R2SymbolIndex::findContaining(ut64 addr) const
+{
+	return findOverlap(addr, 1);
+}
+
+const R2SymbolIndex::Entry *R2SymbolIndex::findOverlap(ut64 addr, ut64 size) const
+{
+	if(!size)
+		return nullptr;
+	ut64 last = addr + size - 1;
+	if(last < addr)
+		last = UT64_MAX;
+
+	// max_last is sorted, so the first entry reaching addr is found by binary search.
+	// All entries before it end below addr, so it is the lowest overlapping one if it starts early enough.
+	auto it = std::lower_bound(max_last.begin(), max_last.end(), addr);
+	if(it == max_last.end())
+		return nullptr;
+	const Entry &entry = entries[it - max_last.begin()];
+	return entry.addr <= last ? &entry : nullptr;
+}
+
+const R2SymbolIndex::Entry *R2SymbolIndex::findBefore(ut64 addr) const
+{
+	auto it = std::lower_bound(entries.begin(), entries.end(), addr, AddrLess);
+	return it != entries.begin() ? &*(it - 1) : nullptr;
+}
+
+const R2SymbolIndex::Entry *R2SymbolIndex::findAfter(ut64 addr) const
+{
+	auto it = std::upper_bound(entries.begin(), entries.end(), addr, [](ut64 addr, const Entry &entry) {
+		return addr < entry.addr;
+	});
+	return it != entries.end() ? &*it : nullptr;
+}
@@ -0,0 +1,65 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#ifndef R2GHIDRA_R2SYMBOLINDEX_H
+#define R2GHIDRA_R2SYMBOLINDEX_H
+
+#include <r_types.h>
+
+#include <vector>
+
+/**
+ * Sorted index of everything in r2 that R2Scope registers as a symbol (functions and flags, including strings),
+ * so lookups by address, containment and neighbours don't have to go through r2 one by one.
+ *
+ * The size of an entry is the size of the symbol that will be registered for it,
+ * which is only the entry point for functions.
+ */
+class R2SymbolIndex
+{
+	public:
+		enum class Kind { FUNCTION, FLAG };
+
+		struct Entry
+		{
+			ut64 addr;
+			ut64 size;
+			Kind kind;
+
+			ut64 last() const { return addr + (size ? size - 1 : 0); }
+		};
+
+	private:
+		std::vector<Entry> entries; // sorted by addr, at most one entry per addr
+		std::vector<ut64> max_last; // max_last[i] = highest last() of entries[0..i]
+
+	public:
+		void add(ut64 addr, ut64 size, Kind kind)	{ entries.push_back({ addr, size ? size : 1, kind }); }
+
+		/**
+		 * Must be called after all entries have been added and before any lookup.
+		 * If there are multiple entries at the same address, the function wins.
+		 */
+		void finish();
+
+		size_t size() const	{ return entries.size(); }
+
+		const Entry *findAt(ut64 addr) const;
+		const Entry *findContaining(ut64 addr) const;
+
+		/**
+		 * @return the entry with the lowest address that overlaps [addr, addr + size)
+		 */
+		const Entry *findOverlap(ut64 addr, ut64 size) const;
+
+		/**
+		 * @return the entry with the highest address lower than addr
+		 */
+		const Entry *findBefore(ut64 addr) const;
+
+		/**
+		 * @return the entry with the lowest address higher than addr
+		 */
+		const Entry *findAfter(ut64 addr) const;
+};
+
+#endif //R2GHIDRA_R2SYMBOLINDEX_H
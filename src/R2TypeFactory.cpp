@@ -2,15 +2,20 @@
 
 #include "R2TypeFactory.h"
 #include "R2Architecture.h"
+#include "R2Snapshot.h"
+#include "R2TypeTable.h"
 
 #include <r_parse.h>
 #include <r_core.h>
 
 #include "R2Utils.h"
 
+std::atomic<ut64> R2TypeFactory::sdbTypesGeneration { 0 };
+
 R2TypeFactory::R2TypeFactory(R2Architecture *arch)
 	: TypeFactory(arch),
-	arch(arch)
+	arch(arch),
+	generation(sdbTypesGeneration)
 {
 	ctype = r_parse_ctype_new();
 	if(!ctype)
@@ -22,98 +27,108 @@ R2TypeFactory::~R2TypeFactory()
 	r_parse_ctype_free(ctype);
 }
 
+int R2TypeFactory::SdbTypesHookCb(void *s, void *user, const char *k, const char *v)
+{
+	sdbTypesGeneration++;
+	return 0;
+}
 
-std::vector<std::string> splitSdbArray(const std::string& str)
+void R2TypeFactory::hookSdbTypes(RCore *core)
 {
-	std::stringstream ss(str);
-	std::string token;
-	std::vector<std::string> r;
-	while(std::getline(ss, token, SDB_RS))
-		r.push_back(token);
-	return r;
+	sdb_hook(core->anal->sdb_types, SdbTypesHookCb, nullptr);
 }
 
-Datatype *R2TypeFactory::queryR2Struct(const string &n)
+void R2TypeFactory::unhookSdbTypes(RCore *core)
 {
-	RCoreLock core(arch->getCore());
+	sdb_unhook(core->anal->sdb_types, SdbTypesHookCb);
+}
+
+void R2TypeFactory::refresh()
+{
+	ut64 cur = sdbTypesGeneration;
+	if(cur == generation)
+		return;
+	cstringCache.clear();
+	typeTable.reset();
+	clearNoncore();
+	generation = cur;
+}
 
-	Sdb *sdb = core->anal->sdb_types;
 
-	// TODO: We REALLY need an API for this in r2
+const R2TypeTable &R2TypeFactory::getTypeTable()
+{
+	const R2Snapshot *snapshot = arch->getSnapshot();
+	if(snapshot)
+		return snapshot->getTypes();
+	if(!typeTable)
+	{
+		RCoreLock core(arch->getCore());
+		typeTable.reset(new R2TypeTable(core->anal->sdb_types));
+	}
+	return *typeTable;
+}
 
-	const char *members = sdb_const_get(sdb, ("struct." + n).c_str(), nullptr);
-	if(!members)
+Datatype *R2TypeFactory::queryR2Struct(const string &n)
+{
+	const R2TypeTable::Struct *s = getTypeTable().getStruct(n);
+	if(!s)
+		return nullptr;
+	if(!s->valid)
+	{
+		arch->addWarning("Failed to load struct " + n + " from sdb.");
 		return nullptr;
+	}
 
 	std::vector<TypeField> fields;
-	try
+	fields.reserve(s->count);
+	for(size_t i = 0; i < s->count; i++)
 	{
-		std::stringstream membersStream(members);
-		std::string memberName;
-		while(std::getline(membersStream, memberName, SDB_RS))
+		const R2TypeTable::StructMember &member = s->members[i];
+		Datatype *memberType = fromCString(*member.type);
+		if(!memberType)
 		{
-			const char *memberContents = sdb_const_get(sdb, ("struct." + n + "." + memberName).c_str(), nullptr);
-			if(!memberContents)
-				continue;
-			auto memberTokens = splitSdbArray(memberContents);
-			if(memberTokens.size() < 3)
-				continue;
-			auto memberTypeName = memberTokens[0];
-			for(size_t i=1; i<memberTokens.size() - 2; i++)
-				memberTypeName += "," + memberTokens[i];
-			int4 offset = std::stoi(memberTokens[memberTokens.size() - 2]);
-			int4 elements = std::stoi(memberTokens[memberTokens.size() - 1]);
-			Datatype *memberType = fromCString(memberTypeName);
-			if(!memberType)
-			{
-				arch->addWarning("Failed to match type " + memberTypeName + " of member " + memberName + " in struct " + n);
-				continue;
-			}
-
-			if(elements > 0)
-				memberType = getTypeArray(elements, memberType);
-
-			fields.push_back({
-				offset,
-				memberName,
-				memberType
-			});
+			arch->addWarning("Failed to match type " + *member.type + " of member " + *member.name + " in struct " + n);
+			continue;
 		}
 
-		TypeStruct *r = getTypeStruct(n);
-		setFields(fields, r, 0);
-		return r;
-	}
-	catch(std::invalid_argument &e)
-	{
-		arch->addWarning("Failed to load struct " + n + " from sdb.");
-		return nullptr;
+		if(member.elements > 0)
+			memberType = getTypeArray(member.elements, memberType);
+
+		fields.push_back({
+			member.offset,
+			*member.name,
+			memberType
+		});
 	}
+
+	TypeStruct *r = getTypeStruct(n);
+	setFields(fields, r, 0);
+	return r;
 }
 
 Datatype *R2TypeFactory::queryR2Enum(const string &n)
 {
-	RCoreLock core(arch->getCore());
-	RList *members = r_type_get_enum(core->anal->sdb_types, n.c_str());
-	if(!members)
+	const R2TypeTable::Enum *e = getTypeTable().getEnum(n);
+	if(!e)
+		return nullptr;
+	if(!e->valid)
+	{
+		arch->addWarning("Failed to load enum " + n + " from sdb.");
+		return nullptr;
+	}
+	if(!e->count)
 		return nullptr;
 
 	std::vector<std::string> namelist;
 	std::vector<uintb> vallist;
-	std::vector<bool> assignlist;
-
-	r_list_foreach_cpp<RTypeEnum>(members, [&](RTypeEnum *member) {
-		if(!member->name || !member->val)
-			return;
-		uintb val = std::stoull(member->val, nullptr, 0);
-		namelist.push_back(member->name);
-		vallist.push_back(val);
-		assignlist.push_back(true); // all enum values from r2 have explicit values
-	});
-	r_list_free (members);
-
-	if(namelist.empty())
-		return nullptr;
+	std::vector<bool> assignlist(e->count, true); // all enum values from r2 have explicit values
+	namelist.reserve(e->count);
+	vallist.reserve(e->count);
+	for(size_t i = 0; i < e->count; i++)
+	{
+		namelist.push_back(*e->members[i].name);
+		vallist.push_back(e->members[i].value);
+	}
 
 	auto enumType = getTypeEnum(n);
 	setEnumValues(namelist, vallist, assignlist, enumType);
@@ -122,13 +137,11 @@ Datatype *R2TypeFactory::queryR2Enum(const string &n)
 
 Datatype *R2TypeFactory::queryR2Typedef(const string &n, std::set<std::string> &stackTypes)
 {
-	RCoreLock core(arch->getCore());
-	Sdb *sdb = core->anal->sdb_types;
-	const char *target = sdb_const_get(sdb, ("typedef." + n).c_str(), nullptr);
+	const std::string *target = getTypeTable().getTypedef(n);
 	if(!target)
 		return nullptr;
 
-	Datatype *resolved = fromCString(target, nullptr, &stackTypes);
+	Datatype *resolved = fromCString(*target, nullptr, &stackTypes);
 	if(!resolved)
 		return nullptr;
 
@@ -146,15 +159,16 @@ Datatype *R2TypeFactory::queryR2(const string &n, std::set<std::string> &stackTy
 	}
 	stackTypes.insert(n);
 
-	RCoreLock core(arch->getCore());
-	int kind = r_type_kind(core->anal->sdb_types, n.c_str());
+	R2TypeTable::Kind kind;
+	if(!getTypeTable().getKind(n, kind))
+		return nullptr;
 	switch(kind)
 	{
-		case R_TYPE_STRUCT:
+		case R2TypeTable::Kind::STRUCT:
 			return queryR2Struct(n);
-		case R_TYPE_ENUM:
+		case R2TypeTable::Kind::ENUM:
 			return queryR2Enum(n);
-		case R_TYPE_TYPEDEF:
+		case R2TypeTable::Kind::TYPEDEF:
 			return queryR2Typedef(n, stackTypes);
 		default:
 			return nullptr;
@@ -176,6 +190,32 @@ Datatype *R2TypeFactory::findById(const string &n, uint8 id)
 }
 
 Datatype *R2TypeFactory::fromCString(const string &str, string *error, std::set<std::string> *stackTypes)
+{
+	auto it = cstringCache.find(str);
+	if(it != cstringCache.end())
+	{
+		if(error)
+			*error = it->second.error;
+		for(const auto &warning : it->second.warnings)
+			arch->addWarning(warning);
+		return it->second.type;
+	}
+
+	size_t warningsBefore = arch->getWarnings().size();
+	std::string parseError;
+	Datatype *r = parseCString(str, &parseError, stackTypes);
+	if(error)
+		*error = parseError;
+	// while other types are being resolved, a failure might only be due to recursion
+	if(r || !stackTypes || stackTypes->empty())
+	{
+		const auto &warnings = arch->getWarnings();
+		cstringCache[str] = { r, parseError, std::vector<std::string>(warnings.begin() + warningsBefore, warnings.end()) };
+	}
+	return r;
+}
+
+Datatype *R2TypeFactory::parseCString(const string &str, string *error, std::set<std::string> *stackTypes)
 {
 	char *error_cstr = nullptr;
 	RParseCTypeType *type = r_parse_ctype_parse(ctype, str.c_str(), &error_cstr);
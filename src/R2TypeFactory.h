@@ -5,10 +5,19 @@
 
 #include <type.hh>
 
+#include <r_types.h>
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 typedef struct r_parse_ctype_t RParseCType;
 typedef struct r_parse_ctype_type_t RParseCTypeType;
+typedef struct r_core_t RCore;
 
 class R2Architecture;
+class R2TypeTable;
 
 class R2TypeFactory : public TypeFactory
 {
@@ -16,6 +25,27 @@ class R2TypeFactory : public TypeFactory
 		R2Architecture *arch;
 		RParseCType *ctype;
 
+		struct CStringResult
+		{
+			Datatype *type;
+			std::string error;
+			std::vector<std::string> warnings; // added to the arch while parsing, emitted again on every hit
+		};
+		std::unordered_map<std::string, CStringResult> cstringCache; // results of fromCString, valid until refresh() drops the types
+
+		static std::atomic<ut64> sdbTypesGeneration;
+		ut64 generation;
+
+		static int SdbTypesHookCb(void *s, void *user, const char *k, const char *v);
+		Datatype *parseCString(const string &str, string *error, std::set<std::string> *stackTypes);
+
+		std::unique_ptr<R2TypeTable> typeTable; // only used without snapshot, read on first use after refresh()
+
+		/**
+		 * @return r2's types from the snapshot if the architecture has one, otherwise read from sdb_types
+		 */
+		const R2TypeTable &getTypeTable();
+
 		Datatype *queryR2Struct(const string &n);
 		Datatype *queryR2Enum(const string &n);
 		Datatype *queryR2Typedef(const string &n, std::set<std::string> &stackTypes);
@@ -31,6 +61,23 @@ class R2TypeFactory : public TypeFactory
 		R2TypeFactory(R2Architecture *arch);
 		~R2TypeFactory() override;
 
+		/**
+		 * Track changes of r2's sdb_types, which make all factories drop their types from r2 on the next refresh()
+		 */
+		static void hookSdbTypes(RCore *core);
+		static void unhookSdbTypes(RCore *core);
+
+		/**
+		 * @return counter that changes whenever sdb_types was written since hookSdbTypes()
+		 */
+		static ut64 getSdbTypesGeneration()	{ return sdbTypesGeneration; }
+
+		/**
+		 * Drop all types that came from r2 and parsed type strings if sdb_types changed since they were created.
+		 * Nothing may reference these types anymore when this is called.
+		 */
+		void refresh();
+
 		Datatype *fromCString(const string &str, string *error = nullptr, std::set<std::string> *stackTypes = nullptr);
 		Datatype *fromCType(const RParseCTypeType *ctype, string *error = nullptr, std::set<std::string> *stackTypes = nullptr);
 };
@@ -0,0 +1,206 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#include "R2TypeTable.h"
+
+#include <r_util.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * Split like std::getline with SDB_RS would, so an empty last element is dropped
+ */
+static void SplitSdbArray(const char *str, std::vector<std::string> &out)
+{
+	out.clear();
+	const char *start = str;
+	for(const char *p = str; ; p++)
+	{
+		if(*p && *p != SDB_RS)
+			continue;
+		if(*p || p != start)
+			out.emplace_back(start, p - start);
+		if(!*p)
+			break;
+		start = p + 1;
+	}
+}
+
+static bool ParseInt(const std::string &str, int &out)
+{
+	const char *s = str.c_str();
+	char *end;
+	errno = 0;
+	long v = strtol(s, &end, 10);
+	if(end == s || errno == ERANGE || v < INT_MIN || v > INT_MAX)
+		return false;
+	out = (int)v;
+	return true;
+}
+
+static bool ParseUt64(const std::string &str, ut64 &out)
+{
+	const char *s = str.c_str();
+	char *end;
+	errno = 0;
+	unsigned long long v = strtoull(s, &end, 0);
+	if(end == s || errno == ERANGE)
+		return false;
+	out = v;
+	return true;
+}
+
+R2TypeTable::R2TypeTable(Sdb *types)
+{
+	std::unordered_map<std::string, const char *> raw;
+	SdbList *kvs = sdb_foreach_list(types, false);
+	SdbListIter *kv_iter;
+	SdbKv *kv;
+	ls_foreach(kvs, kv_iter, kv)
+	{
+		if(sdbkv_key(kv) && sdbkv_value(kv))
+			raw[sdbkv_key(kv)] = sdbkv_value(kv);
+	}
+
+	auto get = [&raw](const std::string &key) -> const char * {
+		auto it = raw.find(key);
+		return it != raw.end() ? it->second : nullptr;
+	};
+
+	// first collect everything, the pointers into the member arrays are only set at the end
+	std::unordered_map<std::string, std::pair<size_t, size_t>> struct_ranges;
+	std::unordered_map<std::string, std::pair<size_t, size_t>> enum_ranges;
+	std::vector<std::string> members;
+	std::vector<std::string> tokens;
+
+	for(const auto &entry : raw)
+	{
+		const std::string &name = entry.first;
+		if(name.find('.') != std::string::npos)
+			continue;
+
+		// same as r_type_kind()
+		const char *kind = entry.second;
+		if(!strcmp(kind, "struct"))
+		{
+			kinds[name] = Kind::STRUCT;
+			const char *list = get("struct." + name);
+			if(!list)
+				continue;
+			bool valid = true;
+			size_t first = struct_members.size();
+			SplitSdbArray(list, members);
+			for(const auto &member : members)
+			{
+				const char *contents = get("struct." + name + "." + member);
+				if(!contents)
+					continue;
+				SplitSdbArray(contents, tokens);
+				if(tokens.size() < 3)
+					continue;
+				std::string type = tokens[0];
+				for(size_t i = 1; i < tokens.size() - 2; i++)
+					type += "," + tokens[i];
+				StructMember m;
+				if(!ParseInt(tokens[tokens.size() - 2], m.offset) || !ParseInt(tokens[tokens.size() - 1], m.elements))
+				{
+					valid = false;
+					break;
+				}
+				m.name = intern(member);
+				m.type = intern(type);
+				struct_members.push_back(m);
+			}
+			if(!valid)
+				struct_members.resize(first);
+			structs[name] = { nullptr, 0, valid };
+			struct_ranges[name] = { first, struct_members.size() - first };
+		}
+		else if(!strcmp(kind, "enum"))
+		{
+			// same layout as read by r_type_get_enum()
+			kinds[name] = Kind::ENUM;
+			const char *list = get("enum." + name);
+			if(!list)
+				continue;
+			bool valid = true;
+			size_t first = enum_members.size();
+			SplitSdbArray(list, members);
+			for(const auto &member : members)
+			{
+				const char *val = member.empty() ? nullptr : get("enum." + name + "." + member);
+				if(!val)
+					continue;
+				SplitSdbArray(val, tokens);
+				if(tokens.empty())
+					continue;
+				EnumMember m;
+				if(!ParseUt64(tokens[0], m.value))
+				{
+					valid = false;
+					break;
+				}
+				m.name = intern(member);
+				enum_members.push_back(m);
+			}
+			if(!valid)
+				enum_members.resize(first);
+			enums[name] = { nullptr, 0, valid };
+			enum_ranges[name] = { first, enum_members.size() - first };
+		}
+		else if(!strcmp(kind, "typedef"))
+		{
+			kinds[name] = Kind::TYPEDEF;
+			const char *target = get("typedef." + name);
+			if(target)
+				typedefs[name] = intern(target);
+		}
+		else
+			kinds[name] = Kind::OTHER;
+	}
+	ls_free(kvs);
+
+	struct_members.shrink_to_fit();
+	enum_members.shrink_to_fit();
+	for(auto &s : structs)
+	{
+		const auto &range = struct_ranges[s.first];
+		s.second.members = struct_members.data() + range.first;
+		s.second.count = range.second;
+	}
+	for(auto &e : enums)
+	{
+		const auto &range = enum_ranges[e.first];
+		e.second.members = enum_members.data() + range.first;
+		e.second.count = range.second;
+	}
+}
+
+bool R2TypeTable::getKind(const std::string &name, Kind &kind) const
+{
+	auto it = kinds.find(name);
+	if(it == kinds.end())
+		return false;
+	kind = it->second;
+	return true;
+}
+
+const R2TypeTable::Struct *R2TypeTable::getStruct(const std::string &name) const
+{
+	auto it = structs.find(name);
+	return it != structs.end() ? &it->second : nullptr;
+}
+
+const R2TypeTable::Enum *R2TypeTable::getEnum(const std::string &name) const
+{
+	auto it = enums.find(name);
+	return it != enums.end() ? &it->second : nullptr;
+}
+
+const std::string *R2TypeTable::getTypedef(const std::string &name) const
+{
+	auto it = typedefs.find(name);
+	return it != typedefs.end() ? it->second : nullptr;
+}
@@ -0,0 +1,84 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#ifndef R2GHIDRA_R2TYPETABLE_H
+#define R2GHIDRA_R2TYPETABLE_H
+
+#include <r_types.h>
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+typedef struct sdb_t Sdb;
+
+/**
+ * Structs, enums and typedefs of r2's sdb_types, read in a single pass
+ *
+ * Names are interned and the members of all structs and enums are kept in flat arrays,
+ * so resolving a type afterwards neither touches sdb nor splits strings.
+ */
+class R2TypeTable
+{
+	public:
+		enum class Kind { STRUCT, ENUM, TYPEDEF, OTHER };
+
+		struct StructMember
+		{
+			const std::string *name;
+			const std::string *type;
+			int offset;
+			int elements;
+		};
+
+		struct Struct
+		{
+			const StructMember *members;
+			size_t count;
+			bool valid; // false if any member could not be parsed
+		};
+
+		struct EnumMember
+		{
+			const std::string *name;
+			ut64 value;
+		};
+
+		struct Enum
+		{
+			const EnumMember *members;
+			size_t count;
+			bool valid; // false if any value could not be parsed
+		};
+
+	private:
+		std::unordered_set<std::string> strings;
+		std::unordered_map<std::string, Kind> kinds;
+		std::unordered_map<std::string, Struct> structs;
+		std::unordered_map<std::string, Enum> enums;
+		std::unordered_map<std::string, const std::string *> typedefs;
+		std::vector<StructMember> struct_members;
+		std::vector<EnumMember> enum_members;
+
+		const std::string *intern(const std::string &str)	{ return &*strings.insert(str).first; }
+
+	public:
+		/**
+		 * Read all of types, the caller must keep r2 locked while this runs
+		 */
+		explicit R2TypeTable(Sdb *types);
+
+		R2TypeTable(const R2TypeTable &) = delete;
+		R2TypeTable &operator=(const R2TypeTable &) = delete;
+
+		/**
+		 * @return false if there is no type called name at all
+		 */
+		bool getKind(const std::string &name, Kind &kind) const;
+
+		const Struct *getStruct(const std::string &name) const;
+		const Enum *getEnum(const std::string &name) const;
+		const std::string *getTypedef(const std::string &name) const;
+};
+
+#endif //R2GHIDRA_R2TYPETABLE_H
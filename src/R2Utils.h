@@ -3,6 +3,12 @@
 #ifndef R2GHIDRA_R2UTILS_H
 #define R2GHIDRA_R2UTILS_H
 
+#include <r_types.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 typedef struct r_list_t RList;
 typedef struct r_list_iter_t RListIter;
 
@@ -24,4 +30,23 @@ template<typename T, typename F> void r_interval_tree_foreach_cpp(RIntervalTree
 	}
 }
 
+/**
+ * Sort ranges and merge overlapping and adjacent ones, so every address is covered only once
+ */
+inline std::vector<std::pair<ut64, ut64>> MergeRanges(std::vector<std::pair<ut64, ut64>> ranges)
+{
+	std::sort(ranges.begin(), ranges.end());
+	std::vector<std::pair<ut64, ut64>> r;
+	for(const auto &range : ranges)
+	{
+		if(range.second <= range.first)
+			continue;
+		if(!r.empty() && range.first <= r.back().second)
+			r.back().second = std::max(r.back().second, range.second);
+		else
+			r.push_back(range);
+	}
+	return r;
+}
+
 #endif //R2GHIDRA_R2UTILS_H
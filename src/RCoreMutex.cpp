@@ -4,8 +4,16 @@
 
 #include <cassert>
 
-RCoreMutex::RCoreMutex(RCore *core) : caffeine_level(1), bed(nullptr), _core(core)
+RCoreMutex::RCoreMutex(RCore *core, std::recursive_mutex *shared) : caffeine_level(1), bed(nullptr), _core(core), shared(shared), acquisitions(0)
 {
+	if(shared)
+		shared->lock();
+}
+
+RCoreMutex::~RCoreMutex()
+{
+	if(shared && caffeine_level > 0)
+		shared->unlock();
 }
 
 void RCoreMutex::sleepEnd()
@@ -14,6 +22,12 @@ void RCoreMutex::sleepEnd()
 	caffeine_level++;
 	if(caffeine_level == 1)
 	{
+		acquisitions++;
+		if(shared)
+		{
+			shared->lock();
+			return;
+		}
 		r_cons_sleep_end(bed);
 		bed = nullptr;
 	}
@@ -31,5 +45,12 @@ void RCoreMutex::sleepBegin()
 	assert(caffeine_level > 0);
 	caffeine_level--;
 	if(caffeine_level == 0)
+	{
+		if(shared)
+		{
+			shared->unlock();
+			return;
+		}
 		bed = r_cons_sleep_begin();
+	}
 }
\ No newline at end of file
@@ -3,11 +3,16 @@
 #ifndef R2GHIDRA_RCOREMUTEX_H
 #define R2GHIDRA_RCOREMUTEX_H
 
+#include <mutex>
+
 typedef struct r_core_t RCore;
 
 /**
  * Maintains sleep/awake state of the current r2 task like a recursive mutex
  * Use with RCoreLock for RAII behavior
+ *
+ * When constructed with a shared mutex (for decompiling from worker threads that are not r2 tasks),
+ * being awake means holding that mutex instead of waking up the r2 task.
  */
 class RCoreMutex
 {
@@ -21,13 +26,21 @@ class RCoreMutex
 		int caffeine_level;
 		void *bed;
 		RCore *_core;
+		std::recursive_mutex *const shared;
+		unsigned long long acquisitions;
 
 	public:
-		RCoreMutex(RCore *core);
+		RCoreMutex(RCore *core, std::recursive_mutex *shared = nullptr);
+		~RCoreMutex();
 
 		void sleepEnd();
 		void sleepEndForce();
 		void sleepBegin();
+
+		/**
+		 * @return how often r2 was woken up (or the shared mutex locked) so far
+		 */
+		unsigned long long getAcquisitions() const	{ return acquisitions; }
 };
 
 class RCoreLock
@@ -0,0 +1,72 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#ifndef R2GHIDRA_RWMUTEX_H
+#define R2GHIDRA_RWMUTEX_H
+
+#include <condition_variable>
+#include <mutex>
+
+/**
+ * Readers-writer mutex with the interface of C++17's std::shared_mutex, which is not available in C++11.
+ * Waiting writers block new readers, so a writer can't be starved.
+ */
+class RWMutex
+{
+	private:
+		std::mutex mutex;
+		std::condition_variable cond;
+		unsigned int readers = 0;
+		unsigned int writers_waiting = 0;
+		bool writer = false;
+
+	public:
+		void lock()
+		{
+			std::unique_lock<std::mutex> l(mutex);
+			writers_waiting++;
+			cond.wait(l, [this]() { return !writer && !readers; });
+			writers_waiting--;
+			writer = true;
+		}
+
+		bool try_lock()
+		{
+			std::lock_guard<std::mutex> l(mutex);
+			if(writer || readers)
+				return false;
+			writer = true;
+			return true;
+		}
+
+		void unlock()
+		{
+			std::lock_guard<std::mutex> l(mutex);
+			writer = false;
+			cond.notify_all();
+		}
+
+		void lock_shared()
+		{
+			std::unique_lock<std::mutex> l(mutex);
+			cond.wait(l, [this]() { return !writer && !writers_waiting; });
+			readers++;
+		}
+
+		bool try_lock_shared()
+		{
+			std::lock_guard<std::mutex> l(mutex);
+			if(writer || writers_waiting)
+				return false;
+			readers++;
+			return true;
+		}
+
+		void unlock_shared()
+		{
+			std::lock_guard<std::mutex> l(mutex);
+			if(!--readers)
+				cond.notify_all();
+		}
+};
+
+#endif //R2GHIDRA_RWMUTEX_H
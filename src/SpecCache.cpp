@@ -0,0 +1,282 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#include "SpecCache.h"
+
+#include <xml.hh>
+#include <error.hh>
+
+#include <r_util.h>
+#include <r_hash.h>
+
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+// bump when the layout of the preparsed files changes
+#define SPEC_CACHE_MAGIC "r2ghidra-spec-1"
+
+namespace
+{
+
+struct SpecFile
+{
+	time_t mtime;
+	off_t size;
+	std::unique_ptr<Document> doc;
+};
+
+/**
+ * Writes the element tree of a document as length-prefixed strings and counts
+ */
+class TreeWriter
+{
+	private:
+		std::string &out;
+
+		void writeU32(ut32 v)
+		{
+			ut8 buf[4];
+			r_write_le32(buf, v);
+			out.append(reinterpret_cast<const char *>(buf), sizeof(buf));
+		}
+
+		void writeString(const std::string &s)
+		{
+			writeU32((ut32)s.size());
+			out += s;
+		}
+
+	public:
+		explicit TreeWriter(std::string &out) : out(out) {}
+
+		void writeElement(const Element *el)
+		{
+			writeString(el->getName());
+			writeString(el->getContent());
+			writeU32((ut32)el->getNumAttributes());
+			for(int4 i = 0; i < el->getNumAttributes(); i++)
+			{
+				writeString(el->getAttributeName(i));
+				writeString(el->getAttributeValue(i));
+			}
+			writeChildren(el);
+		}
+
+		void writeChildren(const Element *el)
+		{
+			const List &children = el->getChildren();
+			writeU32((ut32)children.size());
+			for(const Element *child : children)
+				writeElement(child);
+		}
+};
+
+/**
+ * Rebuilds the element tree written by TreeWriter, fails on any inconsistency
+ */
+class TreeReader
+{
+	private:
+		const char *cur;
+		const char *end;
+
+		bool readU32(ut32 *v)
+		{
+			if(end - cur < 4)
+				return false;
+			*v = r_read_le32(cur);
+			cur += 4;
+			return true;
+		}
+
+		bool readString(std::string *s)
+		{
+			ut32 len;
+			if(!readU32(&len) || (size_t)(end - cur) < len)
+				return false;
+			s->assign(cur, len);
+			cur += len;
+			return true;
+		}
+
+	public:
+		TreeReader(const char *buf, size_t size) : cur(buf), end(buf + size) {}
+
+		bool atEnd() const	{ return cur == end; }
+
+		bool readChildren(Element *parent)
+		{
+			ut32 count;
+			if(!readU32(&count))
+				return false;
+			for(ut32 i = 0; i < count; i++)
+			{
+				Element *el = new Element(parent);
+				parent->addChild(el); // owned by parent from here on, also on failure
+				std::string name;
+				std::string content;
+				ut32 attr_count;
+				if(!readString(&name) || !readString(&content) || !readU32(&attr_count))
+					return false;
+				el->setName(name);
+				el->addContent(content.data(), 0, (int4)content.size());
+				for(ut32 j = 0; j < attr_count; j++)
+				{
+					std::string attr_name;
+					std::string attr_value;
+					if(!readString(&attr_name) || !readString(&attr_value))
+						return false;
+					el->addAttribute(attr_name, attr_value);
+				}
+				if(!readChildren(el))
+					return false;
+			}
+			return true;
+		}
+};
+
+}
+
+// the xml parser is not reentrant, so this also serializes all spec parsing
+static std::mutex spec_mutex;
+static std::map<std::string, SpecFile> spec_files;
+static std::string spec_cache_dir;
+
+// documents that went stale are kept until clear(), because elements might still be referenced
+static std::vector<std::unique_ptr<Document>> spec_files_stale;
+
+static std::string PreparsedPath(const std::string &path)
+{
+	if(spec_cache_dir.empty())
+		return std::string();
+	RHash *ctx = r_hash_new(true, R_HASH_SHA256);
+	if(!ctx)
+		return std::string();
+	const ut8 *digest = r_hash_do_sha256(ctx, reinterpret_cast<const ut8 *>(path.data()), (int)path.size());
+	std::stringstream ss;
+	ss << std::hex;
+	for(int i = 0; i < R_HASH_SIZE_SHA256; i++)
+		ss << ((digest[i] >> 4) & 0xf) << (digest[i] & 0xf);
+	r_hash_free(ctx);
+	return spec_cache_dir + R_SYS_DIR + ss.str() + ".r2gs";
+}
+
+static std::string PreparsedHeader(const std::string &path, const struct stat &st)
+{
+	std::stringstream ss;
+	ss << SPEC_CACHE_MAGIC << '\0' << path << '\0' << (ut64)st.st_mtime << '\0' << (ut64)st.st_size << '\0';
+	return ss.str();
+}
+
+/**
+ * @return the document from the preparsed file of path, or nullptr if there is none or it is stale
+ */
+static Document *LoadPreparsed(const std::string &path, const struct stat &st)
+{
+	std::string cache_path = PreparsedPath(path);
+	if(cache_path.empty())
+		return nullptr;
+	std::ifstream file(cache_path, std::ios::binary);
+	if(!file)
+		return nullptr;
+	std::vector<char> buf((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	std::string header = PreparsedHeader(path, st);
+	if(buf.size() < header.size() || memcmp(buf.data(), header.data(), header.size()) != 0)
+		return nullptr;
+
+	std::unique_ptr<Document> doc(new Document());
+	TreeReader reader(buf.data() + header.size(), buf.size() - header.size());
+	if(!reader.readChildren(doc.get()) || !reader.atEnd() || doc->getChildren().empty())
+		return nullptr;
+	return doc.release();
+}
+
+static void StorePreparsed(const std::string &path, const struct stat &st, const Document *doc)
+{
+	std::string cache_path = PreparsedPath(path);
+	if(cache_path.empty())
+		return;
+	if(!r_file_is_directory(spec_cache_dir.c_str()) && !r_sys_mkdirp(spec_cache_dir.c_str()))
+		return;
+
+	std::string out = PreparsedHeader(path, st);
+	TreeWriter(out).writeChildren(doc);
+
+	// write to a temporary file first, so concurrent sessions never see partial files
+	std::string tmp_path = cache_path + "." + std::to_string(r_sys_getpid()) + ".tmp";
+	bool r;
+	{
+		std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+		file.write(out.data(), out.size());
+		r = file.good();
+	}
+	if(!r || std::rename(tmp_path.c_str(), cache_path.c_str()) != 0)
+		std::remove(tmp_path.c_str());
+}
+
+static Document *ParseSpecFile(const std::string &path)
+{
+	std::ifstream stream(path.c_str());
+	if(!stream)
+		throw LowlevelError("Unable to open spec file " + path);
+	return xml_tree(stream);
+}
+
+const Element *SpecCache::getRoot(const std::string &path)
+{
+	std::lock_guard<std::mutex> lock(spec_mutex);
+
+	struct stat st;
+	if(path.empty() || stat(path.c_str(), &st) != 0)
+		throw LowlevelError("Unable to find spec file " + path);
+
+	auto it = spec_files.find(path);
+	if(it != spec_files.end())
+	{
+		if(it->second.mtime == st.st_mtime && it->second.size == st.st_size)
+			return it->second.doc->getRoot();
+		spec_files_stale.push_back(std::move(it->second.doc));
+		spec_files.erase(it);
+	}
+
+	Document *doc = LoadPreparsed(path, st);
+	if(!doc)
+	{
+		try
+		{
+			doc = ParseSpecFile(path);
+		}
+		catch(XmlError &err)
+		{
+			throw LowlevelError("Error parsing spec file " + path + "\n " + err.explain);
+		}
+		StorePreparsed(path, st, doc);
+	}
+
+	SpecFile &file = spec_files[path];
+	file.mtime = st.st_mtime;
+	file.size = st.st_size;
+	file.doc.reset(doc);
+	return doc->getRoot();
+}
+
+void SpecCache::setDir(const std::string &dir)
+{
+	std::lock_guard<std::mutex> lock(spec_mutex);
+	spec_cache_dir = dir;
+}
+
+void SpecCache::clear()
+{
+	std::lock_guard<std::mutex> lock(spec_mutex);
+	spec_files.clear();
+	spec_files_stale.clear();
+}
@@ -0,0 +1,35 @@
+/* radare - LGPL - Copyright 2020 - thestr4ng3r */
+
+#ifndef R2GHIDRA_SPECCACHE_H
+#define R2GHIDRA_SPECCACHE_H
+
+#include <string>
+
+class Element;
+
+/**
+ * Process-wide cache of parsed Sleigh spec documents (.sla, .pspec, .cspec)
+ * Files are only parsed again when their size or mtime changed,
+ * so initializing another architecture for an already seen language skips the xml parser completely.
+ *
+ * If a directory is set, the element trees are also stored there in a preparsed binary form,
+ * keyed by path, mtime and size, so new sessions skip the xml parser as well.
+ * This only replaces the parser, Sleigh::restoreXml still builds its tables from the element tree.
+ */
+class SpecCache
+{
+	public:
+		/**
+		 * @return root element of the parsed document, valid until clear() is called
+		 */
+		static const Element *getRoot(const std::string &path);
+
+		/**
+		 * @param dir directory for the preparsed files, empty to disable them
+		 */
+		static void setDir(const std::string &dir);
+
+		static void clear();
+};
+
+#endif //R2GHIDRA_SPECCACHE_H
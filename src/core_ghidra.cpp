@@ -3,6 +3,14 @@
 #include "R2Architecture.h"
 #include "CodeXMLParse.h"
 #include "ArchMap.h"
+#include "ArchCache.h"
+#include "DecompileCache.h"
+#include "DecompileProfile.h"
+#include "R2Scope.h"
+#include "R2Snapshot.h"
+#include "R2TypeFactory.h"
+#include "SpecCache.h"
+#include "RWMutex.h"
 
 // Windows clash
 #ifdef restrict
@@ -14,8 +22,16 @@
 
 #include <r_core.h>
 
+#include "R2Utils.h"
+
 #include <vector>
 #include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
+#include <chrono>
+#include <memory>
 
 #define CMD_PREFIX "pdg"
 #define CFG_PREFIX "r2ghidra"
@@ -52,6 +68,7 @@ struct ConfigVar
 std::vector<const ConfigVar *> ConfigVar::vars_all;
 
 bool SleighHomeConfig(void *user, void *data);
+bool CacheDirConfig(void *user, void *data);
 
 static const ConfigVar cfg_var_sleighhome   ("sleighhome",  "",         "SLEIGHHOME", SleighHomeConfig);
 static const ConfigVar cfg_var_sleighid     ("lang",        "",         "Custom Sleigh ID to override auto-detection (e.g. x86:LE:32:default)");
@@ -63,27 +80,74 @@ static const ConfigVar cfg_var_indent       ("indent",      "4",        "Indent
 static const ConfigVar cfg_var_linelen      ("linelen",     "120",      "Max line length");
 static const ConfigVar cfg_var_rawptr       ("rawptr",      "true",     "Show unknown globals as raw addresses instead of variables");
 static const ConfigVar cfg_var_verbose      ("verbose",      "true",    "Show verbose warning messages while decompiling");
+static const ConfigVar cfg_var_threads      ("threads",     "0",        "Number of worker threads for pdga (0 for one per core)");
+static const ConfigVar cfg_var_cache_dir    ("cache.dir",   "",         "Directory for caching decompiled functions and preparsed Sleigh spec XML across sessions (empty to disable)", CacheDirConfig);
+static const ConfigVar cfg_var_cache_size   ("cache.size",  "32",       "Number of decompiled functions to keep in memory (0 to disable)");
+static const ConfigVar cfg_var_profile      ("profile",     "full",     "Decompiler passes to run: full, or fast to skip type propagation and some cleanup passes");
+static const ConfigVar cfg_var_timeout      ("timeout",     "0",        "Max milliseconds per function before only its low-level p-code is printed (0 for no limit)");
+static const ConfigVar cfg_var_maxiter      ("maxiter",     "0",        "Max passes of the main simplification loop per function (0 for no limit)");
+
+
 
+// Sleigh's language descriptions and spec paths, which every decompilation reads
+static RWMutex language_mutex;
 
+// guarded by language_mutex
+static bool languages_loaded = false;
 
-static std::recursive_mutex decompiler_mutex;
+// thread-safe by themselves, architectures are checked out exclusively
+static ArchCache arch_cache;
+static DecompileMemoryCache memory_cache;
 
-class DecompilerLock
+/**
+ * Holds language_mutex, shared for everything that only reads the Sleigh state
+ * and exclusive for changing it.
+ * Shared holders never wait for each other, so decompilations can run in parallel
+ * and listing languages doesn't wait for an in-flight decompilation.
+ */
+class LanguageLock
 {
+	private:
+		const bool exclusive;
+
+		static void acquire(bool exclusive)
+		{
+			if(exclusive ? language_mutex.try_lock() : language_mutex.try_lock_shared())
+				return;
+			// the holder might need to access r2 while we wait
+			void *bed = r_cons_sleep_begin();
+			if(exclusive)
+				language_mutex.lock();
+			else
+				language_mutex.lock_shared();
+			r_cons_sleep_end(bed);
+		}
+
 	public:
-		DecompilerLock()
+		explicit LanguageLock(bool exclusive = false) : exclusive(exclusive)
 		{
-			if(!decompiler_mutex.try_lock())
+			acquire(exclusive);
+			while(!exclusive && !languages_loaded)
 			{
-				void *bed = r_cons_sleep_begin();
-				decompiler_mutex.lock();
-				r_cons_sleep_end(bed);
+				// collect the language descriptions once, which modifies the shared state
+				language_mutex.unlock_shared();
+				acquire(true);
+				if(!languages_loaded)
+				{
+					SleighArchitecture::collectSpecFiles(std::cerr);
+					languages_loaded = true;
+				}
+				language_mutex.unlock();
+				acquire(false);
 			}
 		}
 
-		~DecompilerLock()
+		~LanguageLock()
 		{
-			decompiler_mutex.unlock();
+			if(exclusive)
+				language_mutex.unlock();
+			else
+				language_mutex.unlock_shared();
 		}
 };
 
@@ -95,7 +159,13 @@ static void PrintUsage(const RCore *const core)
 		CMD_PREFIX"d",  "", "# Dump the debug XML Dump",
 		CMD_PREFIX"x",  "", "# Dump the XML of the current decompiled function",
 		CMD_PREFIX"j",  "", "# Dump the current decompiled function as JSON",
+		CMD_PREFIX"b",  "", "# Dump the current decompiled function in the compact binary format, base64 encoded",
+		CMD_PREFIX"bd", "[o*j] dump", "# Print a dump of " CMD_PREFIX "b like " CMD_PREFIX "[o*j] would",
 		CMD_PREFIX"o",  "", "# Decompile current function side by side with offsets",
+		CMD_PREFIX"a",  "", "# Decompile all functions in parallel",
+		CMD_PREFIX"aj", " [file]", "# Decompile all functions in parallel as one JSON object per line, streamed to file if given",
+		CMD_PREFIX"T",  "", "# Decompile current function on a new architecture and print timings and counters per phase",
+		CMD_PREFIX"Tj", "", "# Print timings and counters per phase as JSON",
 		CMD_PREFIX"s",  "", "# Display loaded Sleigh Languages",
 		CMD_PREFIX"ss", "", "# Display automatically matched Sleigh Language ID",
 		CMD_PREFIX"sd", " N", "# Disassemble N instructions with Sleigh and print pcode",
@@ -108,7 +178,7 @@ static void PrintUsage(const RCore *const core)
 	r_cons_cmd_help(help, core->print->flags & R_PRINT_FLAGS_COLOR);
 }
 
-enum class DecompileMode { DEFAULT, XML, DEBUG_XML, OFFSET, STATEMENTS, JSON };
+enum class DecompileMode { DEFAULT, XML, DEBUG_XML, OFFSET, STATEMENTS, JSON, BINARY, PROFILE, PROFILE_JSON };
 
 //#define DEBUG_EXCEPTIONS
 
@@ -132,127 +202,331 @@ static void ApplyPrintCConfig(RConfig *cfg, PrintC *print_c)
 	print_c->setMaxLineSize(cfg_var_linelen.GetInt(cfg));
 }
 
-static void Decompile(RCore *core, DecompileMode mode)
+static bool FastProfile(RConfig *cfg)
 {
-	DecompilerLock lock;
+	return cfg_var_profile.GetString(cfg) == "fast";
+}
 
-#ifndef DEBUG_EXCEPTIONS
-	try
-	{
-#endif
-		RAnalFunction *function = r_anal_get_fcn_in(core->anal, core->offset, R_ANAL_FCN_TYPE_NULL);
-		if(!function)
-			throw LowlevelError("No function at this offset");
+static void ApplyBudgetConfig(RConfig *cfg, DecompileBudget &budget)
+{
+	budget.timeout_ms = cfg_var_timeout.GetInt(cfg);
+	budget.max_iterations = cfg_var_maxiter.GetInt(cfg);
+}
 
-		R2Architecture arch(core, cfg_var_sleighid.GetString(core->config));
-		DocumentStorage store;
-		arch.setRawPtr(cfg_var_rawptr.GetBool(core->config));
-		arch.init(store);
+/**
+ * Enables r2's break handling (^C) for its lifetime.
+ * If a budget is given, it is cancelled by ^C until the scope ends,
+ * so a cached architecture never keeps polling the console after it was returned.
+ */
+class ConsBreakScope
+{
+	private:
+		DecompileBudget *budget;
 
-		std::stringstream out_stream;
-		arch.print->setOutputStream(&out_stream);
+	public:
+		explicit ConsBreakScope(DecompileBudget *budget = nullptr)
+			: budget(budget)
+		{
+			r_cons_break_push(nullptr, nullptr);
+			if(budget)
+				budget->cancel = []() { return r_cons_is_breaked(); };
+		}
+
+		~ConsBreakScope()
+		{
+			if(budget)
+				budget->cancel = nullptr;
+			r_cons_break_pop();
+		}
+};
+
+/**
+ * All config vars that influence the output of a decompilation, for keying the cache
+ */
+static std::string OutputConfigString(RConfig *cfg)
+{
+	std::string r;
+	for(const auto var : ConfigVar::GetAll())
+	{
+		// partial results are never cached, so the budget does not influence the cached output
+		if(var == &cfg_var_sleighhome || var == &cfg_var_threads || var == &cfg_var_cache_dir || var == &cfg_var_cache_size
+				|| var == &cfg_var_timeout || var == &cfg_var_maxiter)
+			continue;
+		// the profile selects the action group, so key on the group actually used
+		if(var == &cfg_var_profile)
+		{
+			r += std::string(var->GetName()) + "=" + (FastProfile(cfg) ? "fast" : "full") + "\n";
+			continue;
+		}
+		r += std::string(var->GetName()) + "=" + var->GetString(cfg) + "\n";
+	}
+	return r;
+}
 
-		arch.setPrintLanguage("r2-c-language");
-		ApplyPrintCConfig(core->config, dynamic_cast<PrintC *>(arch.print));
+/**
+ * Run the decompiler actions on the function at addr
+ * arch must already be reset for decompiling this function.
+ */
+static Funcdata *AnalyzeFunction(R2Architecture &arch, ut64 addr, bool verbose)
+{
+	Funcdata *func = arch.symboltab->getGlobalScope()->findFunction(Address(arch.getDefaultCodeSpace(), addr));
+	if(!func)
+		throw LowlevelError("No function in Scope");
 
-		Funcdata *func = arch.symboltab->getGlobalScope()->findFunction(Address(arch.getDefaultCodeSpace(), function->addr));
-		if(!func)
-			throw LowlevelError("No function in Scope");
+	arch.getLoadImage()->prefetchFunction(addr);
 
-		arch.getCore()->sleepBegin();
-		auto action = arch.allacts.getCurrent();
-		int res;
+	arch.getCore()->sleepBegin();
+	auto action = arch.allacts.getCurrent();
+	int res;
 #ifndef DEBUG_EXCEPTIONS
-		try
-		{
+	try
+	{
 #endif
-			action->reset(*func);
-			res = action->perform(*func);
+		action->reset(*func);
+		arch.getBudget().start();
+		ProfileTimer timer(arch.getProfile(), DecompileProfile::PERFORM);
+		res = action->perform(*func);
 #ifndef DEBUG_EXCEPTIONS
-		}
-		catch(const LowlevelError &error)
-		{
-			arch.getCore()->sleepEndForce();
-			throw error;
-		}
+	}
+	catch(...)
+	{
+		arch.getCore()->sleepEndForce();
+		throw;
+	}
 #endif
-		arch.getCore()->sleepEnd();
-		if (res<0)
-			eprintf("break\n");
-		/*else
-		{
-			eprintf("Decompilation complete\n");
-			if(res==0)
-				eprintf("(no change)\n");
-		}*/
+	arch.getCore()->sleepEnd();
+	if(arch.getBudget().isCancelled())
+		throw LowlevelError("Decompilation cancelled");
+	if (res<0 && !arch.getBudget().isExceeded())
+		eprintf("break\n");
+	/*else
+	{
+		eprintf("Decompilation complete\n");
+		if(res==0)
+			eprintf("(no change)\n");
+	}*/
 
-		if(cfg_var_verbose.GetBool(core->config))
-		{
-			for(const auto &warning : arch.getWarnings())
-				func->warningHeader("[r2ghidra] " + warning);
-		}
+	if(verbose)
+	{
+		for(const auto &warning : arch.getWarnings())
+			func->warningHeader("[r2ghidra] " + warning);
+	}
 
-		switch (mode)
+	return func;
+}
+
+/**
+ * Stand-in for the code of a function whose decompilation was stopped by the budget:
+ * a warning followed by the raw p-code of its blocks in the state they were in when it stopped
+ */
+static RAnnotatedCode *PartialCode(R2Architecture &arch, Funcdata *func)
+{
+	std::stringstream raw;
+	func->printRaw(raw);
+
+	std::stringstream ss;
+	ss << "// WARNING: [r2ghidra] Decompilation of " << func->getName() << " stopped after "
+			<< arch.getBudget().describe() << ", only its low-level p-code is available\n";
+	std::string line;
+	while(std::getline(raw, line))
+		ss << "// " << line << "\n";
+	return r_annotated_code_new(strdup(ss.str().c_str()));
+}
+
+static void PrintAnnotatedCode(RAnnotatedCode *code, DecompileMode mode)
+{
+	switch(mode)
+	{
+		case DecompileMode::OFFSET:
 		{
-			case DecompileMode::XML:
-			case DecompileMode::DEFAULT:
-			case DecompileMode::JSON:
-			case DecompileMode::OFFSET:
-			case DecompileMode::STATEMENTS:
-				arch.print->setXML(true);
-				break;
-			default:
-				break;
+			RVector *offsets = r_annotated_code_line_offsets(code);
+			r_annotated_code_print(code, offsets);
+			r_vector_free(offsets);
 		}
+		break;
+		case DecompileMode::STATEMENTS:
+			r_annotated_code_print_comment_cmds(code);
+			break;
+		case DecompileMode::JSON:
+			r_annotated_code_print_json(code);
+			break;
+		case DecompileMode::BINARY:
+			r_annotated_code_print_serialized(code);
+			break;
+		default:
+			r_annotated_code_print(code, nullptr);
+			break;
+	}
+}
+
+static void Decompile(RCore *core, DecompileMode mode)
+{
+	LanguageLock lock;
 
-		if(mode == DecompileMode::XML)
+#ifndef DEBUG_EXCEPTIONS
+	try
+	{
+#endif
+		RAnalFunction *function = r_anal_get_fcn_in(core->anal, core->offset, R_ANAL_FCN_TYPE_NULL);
+		if(!function)
+			throw LowlevelError("No function at this offset");
+
+		DecompileProfile profile;
+		bool profiling = mode == DecompileMode::PROFILE || mode == DecompileMode::PROFILE_JSON;
+
+		// only the annotated code based modes can be answered from the cache
+		bool cacheable = mode == DecompileMode::DEFAULT || mode == DecompileMode::JSON || mode == DecompileMode::BINARY
+				|| mode == DecompileMode::OFFSET || mode == DecompileMode::STATEMENTS;
+		std::string cache_dir = cacheable ? cfg_var_cache_dir.GetString(core->config) : std::string();
+		size_t cache_size = cacheable ? cfg_var_cache_size.GetInt(core->config) : 0;
+		std::string cache_key;
+		std::string memory_cache_key;
+		ut64 memory_cache_generation = 0;
+		std::shared_ptr<RAnnotatedCode> code;
+		bool from_memory_cache = false;
+		if(!cache_dir.empty() || cache_size)
 		{
-			out_stream << "<result><function>";
-			func->saveXml(out_stream, 0, true);
-			out_stream << "</function><code>";
+			std::string sleigh_id = cfg_var_sleighid.GetString(core->config);
+			if(sleigh_id.empty())
+				sleigh_id = SleighIdFromCore(core);
+			std::string context = sleigh_id + "\n" + OutputConfigString(core->config);
+			memory_cache.setCapacity(cache_size);
+			if(cache_size)
+			{
+				// sampled first, so changes while computing the key or decompiling invalidate the result
+				memory_cache_generation = memory_cache.getGeneration();
+				memory_cache_key = DecompileCache::computeKey(core, function, context, false);
+				code = memory_cache.get(memory_cache_key);
+				from_memory_cache = code != nullptr;
+			}
+			if(!code && !cache_dir.empty())
+			{
+				cache_key = DecompileCache::computeKey(core, function, context);
+				code = AnnotatedCodePtr(DecompileCache::load(cache_dir, cache_key));
+			}
 		}
 
-		RAnnotatedCode *code = nullptr;
-		switch(mode)
+		std::stringstream out_stream;
+		bool partial = false;
+		if(!code)
 		{
-			case DecompileMode::XML:
-			case DecompileMode::DEFAULT:
-			case DecompileMode::JSON:
-			case DecompileMode::OFFSET:
-			case DecompileMode::STATEMENTS:
-				arch.print->docFunction(func);
-				if(mode != DecompileMode::XML)
-				{
-					code = ParseCodeXML(func, out_stream.str().c_str());
-					if (!code)
-						throw LowlevelError("Failed to parse XML code from Decompiler");
-				}
-				break;
-			case DecompileMode::DEBUG_XML:
-				arch.saveXml(out_stream);
-				break;
-			default:
-				break;
+			// when profiling, a cached architecture would hide the init and translator build phases
+			ArchCache::Lease lease = arch_cache.checkout(core, cfg_var_sleighid.GetString(core->config), cfg_var_rawptr.GetBool(core->config),
+					FastProfile(core->config), profiling ? &profile : nullptr, profiling);
+			R2Architecture &arch = *lease;
+			auto core_locks_start = arch.getCore()->getAcquisitions();
+
+			arch.print->setOutputStream(&out_stream);
+
+			arch.setPrintLanguage("r2-c-language");
+			ApplyPrintCConfig(core->config, dynamic_cast<PrintC *>(arch.print));
+			ApplyBudgetConfig(core->config, arch.getBudget());
+
+			ConsBreakScope break_scope(&arch.getBudget());
+			Funcdata *func = AnalyzeFunction(arch, function->addr, cfg_var_verbose.GetBool(core->config));
+			partial = arch.getBudget().isExceeded();
+			if(partial && mode == DecompileMode::XML)
+				throw LowlevelError("Decompilation stopped after " + arch.getBudget().describe());
+
+			switch (mode)
+			{
+				case DecompileMode::XML:
+				case DecompileMode::DEFAULT:
+				case DecompileMode::JSON:
+				case DecompileMode::BINARY:
+				case DecompileMode::OFFSET:
+				case DecompileMode::STATEMENTS:
+				case DecompileMode::PROFILE:
+				case DecompileMode::PROFILE_JSON:
+					arch.print->setXML(true);
+					break;
+				default:
+					arch.print->setXML(false);
+					break;
+			}
+
+			if(mode == DecompileMode::XML)
+			{
+				out_stream << "<result><function>";
+				func->saveXml(out_stream, 0, true);
+				out_stream << "</function><code>";
+			}
+
+			switch(mode)
+			{
+				case DecompileMode::XML:
+				case DecompileMode::DEFAULT:
+				case DecompileMode::JSON:
+				case DecompileMode::BINARY:
+				case DecompileMode::OFFSET:
+				case DecompileMode::STATEMENTS:
+				case DecompileMode::PROFILE:
+				case DecompileMode::PROFILE_JSON:
+					if(mode == DecompileMode::XML)
+						arch.print->docFunction(func);
+					else if(partial)
+						code = AnnotatedCodePtr(PartialCode(arch, func));
+					else
+					{
+						// annotations are collected while the markup is emitted, it is never stored as a whole
+						ProfileTimer timer(arch.getProfile(), DecompileProfile::PRINT);
+						CodeXMLStream code_stream(func);
+						arch.print->setOutputStream(&code_stream);
+						arch.print->docFunction(func);
+						arch.print->setOutputStream(&out_stream);
+						code = AnnotatedCodePtr(code_stream.takeCode());
+						if (!code)
+							throw LowlevelError("Failed to parse XML code from Decompiler");
+					}
+					break;
+				case DecompileMode::DEBUG_XML:
+					arch.saveXml(out_stream);
+					break;
+				default:
+					break;
+			}
+
+			if(code && !partial && !cache_dir.empty())
+				DecompileCache::store(cache_dir, cache_key, code.get());
+
+			profile.load_image_cache_hits = arch.getLoadImage()->getCacheHits();
+			profile.load_image_cache_misses = arch.getLoadImage()->getCacheMisses();
+			profile.core_locks = arch.getCore()->getAcquisitions() - core_locks_start;
+			auto scope = dynamic_cast<R2Scope *>(arch.symboltab->getGlobalScope());
+			if(scope)
+			{
+				profile.scope_negative_hits = scope->getNegativeCacheHits();
+				profile.scope_negative_misses = scope->getNegativeCacheMisses();
+			}
 		}
+		if(code && !partial && !from_memory_cache && !memory_cache_key.empty())
+			memory_cache.put(memory_cache_key, code, memory_cache_generation);
 
 		switch(mode)
 		{
 			case DecompileMode::OFFSET:
-			{
-				RVector *offsets = r_annotated_code_line_offsets(code);
-				r_annotated_code_print(code, offsets);
-				r_vector_free(offsets);
-			}
-			break;
 			case DecompileMode::DEFAULT:
-				r_annotated_code_print(code, nullptr);
-				break;
 			case DecompileMode::STATEMENTS:
-				r_annotated_code_print_comment_cmds(code);
-				break;
 			case DecompileMode::JSON:
-				r_annotated_code_print_json(code);
+			case DecompileMode::BINARY:
+				PrintAnnotatedCode(code.get(), mode);
 				break;
+			case DecompileMode::PROFILE:
+			case DecompileMode::PROFILE_JSON:
+			{
+				{
+					// only measured, the output is discarded
+					ProfileTimer timer(&profile, DecompileProfile::RENDER);
+					r_cons_push();
+					r_annotated_code_print(code.get(), nullptr);
+					r_cons_pop();
+				}
+				if(mode == DecompileMode::PROFILE_JSON)
+					profile.printJson();
+				else
+					profile.printTable();
+			}
+			break;
 			case DecompileMode::XML:
 				out_stream << "</code></result>";
 				// fallthrough
@@ -260,14 +534,12 @@ static void Decompile(RCore *core, DecompileMode mode)
 				r_cons_printf("%s\n", out_stream.str().c_str());
 				break;
 		}
-
-		r_annotated_code_free(code);
 #ifndef DEBUG_EXCEPTIONS
 	}
 	catch(const LowlevelError &error)
 	{
 		std::string s = "Ghidra Decompiler Error: " + error.explain;
-		if(mode == DecompileMode::JSON)
+		if(mode == DecompileMode::JSON || mode == DecompileMode::PROFILE_JSON)
 		{
 			PJ *pj = pj_new ();
 			if(!pj)
@@ -281,6 +553,8 @@ static void Decompile(RCore *core, DecompileMode mode)
 			r_cons_printf ("%s\n", pj_string (pj));
 			pj_free(pj);
 		}
+		else if(mode == DecompileMode::BINARY)
+			r_cons_printf("// %s\n", s.c_str()); // not a valid dump, so readers can show it as is
 		else
 			eprintf("%s\n", s.c_str());
 	}
@@ -288,6 +562,302 @@ static void Decompile(RCore *core, DecompileMode mode)
 }
 
 
+struct BatchJob
+{
+	ut64 addr;
+	std::string name;
+	RAnnotatedCode *code;
+	std::vector<std::string> warnings;
+	std::string error;
+	ut64 ns;
+	bool partial; // stopped by the budget
+	bool done;
+};
+
+static RAnnotatedCode *DecompileBatchJob(R2Architecture &arch, const BatchJob &job, bool verbose, std::vector<std::string> *warnings, bool *partial)
+{
+	arch.print->setXML(true);
+
+	Funcdata *func;
+	{
+		// r2 data comes from the snapshot, the lock is only taken while the decompiler is not running
+		RCoreLock core_lock(arch.getCore());
+		arch.resetFunctionState();
+		func = AnalyzeFunction(arch, job.addr, verbose);
+		*warnings = arch.getWarnings();
+	}
+	*partial = arch.getBudget().isExceeded();
+	if(*partial)
+		return PartialCode(arch, func);
+	CodeXMLStream code_stream(func);
+	arch.print->setOutputStream(&code_stream);
+	arch.print->docFunction(func);
+	arch.print->setOutputStream(nullptr);
+	RAnnotatedCode *code = code_stream.takeCode();
+	if(!code)
+		throw LowlevelError("Failed to parse XML code from Decompiler");
+	return code;
+}
+
+/**
+ * Print a finished job as a single line of JSON, either to out or to r_cons if out is nullptr
+ */
+static void PrintBatchJobJson(const BatchJob &job, FILE *out)
+{
+	PJ *pj = pj_new();
+	if(!pj)
+		return;
+	pj_o(pj);
+	pj_ks(pj, "name", job.name.c_str());
+	pj_kn(pj, "addr", job.addr);
+	if(job.code)
+		r_annotated_code_json(job.code, pj);
+	pj_k(pj, "warnings");
+	pj_a(pj);
+	for(const auto &warning : job.warnings)
+		pj_s(pj, warning.c_str());
+	pj_end(pj);
+	if(!job.error.empty())
+	{
+		pj_k(pj, "errors");
+		pj_a(pj);
+		pj_s(pj, ("Ghidra Decompiler Error: " + job.error).c_str());
+		pj_end(pj);
+	}
+	pj_kn(pj, "ns", job.ns);
+	pj_kb(pj, "partial", job.partial);
+	pj_end(pj);
+	if(out)
+	{
+		fprintf(out, "%s\n", pj_string(pj));
+		fflush(out);
+	}
+	else
+		r_cons_printf("%s\n", pj_string(pj));
+	pj_free(pj);
+}
+
+/**
+ * Decompile all functions using a pool of worker threads, each owning a separate R2Architecture.
+ * Everything the decompiler needs from r2 is captured into an R2Snapshot first, which the workers read without locking.
+ * The remaining r2 accesses of workers happen while holding a mutex shared between them,
+ * and the main thread prints the results in order of the function list.
+ *
+ * With json, every function is printed as one line of JSON (NDJSON).
+ * If json_path is not empty, these lines are written to that file directly as soon as each function is done,
+ * instead of being buffered in r_cons until the command finishes.
+ * r_cons is not flushed per line, because that would also break output captured by backticks, pipes or r2pipe.
+ */
+static void DecompileAll(RCore *core, bool json, const std::string &json_path)
+{
+	LanguageLock lock;
+
+	// Taken before any worker starts, r2 can't change the function list while the workers are running
+	std::vector<BatchJob> jobs;
+	r_list_foreach_cpp<RAnalFunction>(core->anal->fcns, [&](RAnalFunction *fcn) {
+		jobs.push_back({ fcn->addr, fcn->name ? fcn->name : "", nullptr, {}, std::string(), 0, false, false });
+	});
+	if(jobs.empty())
+		return;
+
+	std::unique_ptr<FILE, int (*)(FILE *)> json_file(nullptr, fclose);
+	if(json && !json_path.empty())
+	{
+		json_file.reset(fopen(json_path.c_str(), "w"));
+		if(!json_file)
+		{
+			eprintf("Failed to open %s for writing\n", json_path.c_str());
+			return;
+		}
+	}
+
+	std::string sleigh_id;
+	try
+	{
+		sleigh_id = cfg_var_sleighid.GetString(core->config);
+		if(sleigh_id.empty())
+			sleigh_id = SleighIdFromCore(core);
+	}
+	catch(const LowlevelError &error)
+	{
+		eprintf("Ghidra Decompiler Error: %s\n", error.explain.c_str());
+		return;
+	}
+	bool rawptr = cfg_var_rawptr.GetBool(core->config);
+	bool fast = FastProfile(core->config);
+	bool verbose = cfg_var_verbose.GetBool(core->config);
+	std::string filename = FilenameFromCore(core);
+
+	R2Snapshot snapshot(core);
+
+	size_t threads_count = cfg_var_threads.GetInt(core->config);
+	if(!threads_count)
+		threads_count = std::max(std::thread::hardware_concurrency(), 1u);
+	threads_count = std::min(threads_count, jobs.size());
+
+	std::recursive_mutex core_mutex;
+	std::mutex jobs_mutex;
+	std::condition_variable jobs_cond;
+	std::atomic<size_t> next_job(0);
+	std::atomic<bool> cancelled(false); // set by the main thread on ^C, polled by the workers
+
+	auto worker = [&]() {
+		std::unique_ptr<R2Architecture> arch;
+		std::string init_error;
+		try
+		{
+			arch.reset(new R2Architecture(core, sleigh_id, filename, &core_mutex));
+			DocumentStorage store;
+			arch->setRawPtr(rawptr);
+			arch->setFast(fast);
+			arch->setSnapshot(&snapshot);
+			arch->init(store);
+			arch->setPrintLanguage("r2-c-language");
+			ApplyPrintCConfig(core->config, dynamic_cast<PrintC *>(arch->print));
+			ApplyBudgetConfig(core->config, arch->getBudget());
+			arch->getBudget().cancel = [&cancelled]() { return cancelled.load(); };
+			arch->getCore()->sleepBegin();
+		}
+		// nothing may escape the thread, which would terminate r2
+		catch(const LowlevelError &error)
+		{
+			init_error = error.explain;
+			arch.reset();
+		}
+		catch(const XmlError &error)
+		{
+			init_error = error.explain;
+			arch.reset();
+		}
+		catch(const std::exception &error)
+		{
+			init_error = error.what();
+			arch.reset();
+		}
+		catch(...)
+		{
+			init_error = "Unknown error";
+			arch.reset();
+		}
+
+		for(size_t i = next_job++; i < jobs.size(); i = next_job++)
+		{
+			BatchJob &job = jobs[i];
+			RAnnotatedCode *code = nullptr;
+			std::vector<std::string> warnings;
+			std::string error;
+			bool partial = false;
+			auto start = std::chrono::steady_clock::now();
+			if(!arch)
+				error = init_error;
+			else if(cancelled)
+				error = "Decompilation cancelled";
+			else
+			{
+				try
+				{
+					code = DecompileBatchJob(*arch, job, verbose, &warnings, &partial);
+				}
+				catch(const LowlevelError &e)
+				{
+					error = e.explain;
+				}
+				catch(const XmlError &e)
+				{
+					error = e.explain;
+				}
+				catch(const std::exception &e)
+				{
+					error = e.what();
+				}
+				catch(...)
+				{
+					error = "Unknown error";
+				}
+			}
+			ut64 ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+			std::lock_guard<std::mutex> jobs_lock(jobs_mutex);
+			job.code = code;
+			job.warnings = std::move(warnings);
+			job.error = error;
+			job.ns = ns;
+			job.partial = partial;
+			job.done = true;
+			jobs_cond.notify_one();
+		}
+	};
+
+	ConsBreakScope break_scope;
+	std::vector<std::thread> threads;
+	for(size_t i = 0; i < threads_count; i++)
+		threads.emplace_back(worker);
+
+	for(auto &job : jobs)
+	{
+		{
+			std::unique_lock<std::mutex> jobs_lock(jobs_mutex);
+			while(!jobs_cond.wait_for(jobs_lock, std::chrono::milliseconds(50), [&job]() { return job.done; }))
+			{
+				if(!cancelled && r_cons_is_breaked())
+					cancelled = true;
+			}
+		}
+
+		// after a cancel the remaining jobs finish quickly and their results are dropped
+		if(cancelled)
+		{
+			r_annotated_code_free(job.code);
+			job.code = nullptr;
+			continue;
+		}
+
+		if(json_file)
+			PrintBatchJobJson(job, json_file.get());
+		else
+		{
+			std::lock_guard<std::recursive_mutex> core_lock(core_mutex);
+			if(json)
+				PrintBatchJobJson(job, nullptr);
+			else
+			{
+				r_cons_printf("// %s @ 0x%08" PFMT64x "\n", job.name.c_str(), job.addr);
+				if(job.code)
+					r_annotated_code_print(job.code, nullptr);
+				else
+					r_cons_printf("// Ghidra Decompiler Error: %s\n", job.error.c_str());
+				r_cons_printf("\n");
+			}
+		}
+		r_annotated_code_free(job.code);
+		job.code = nullptr;
+		job.warnings.clear();
+	}
+
+	for(auto &thread : threads)
+		thread.join();
+
+	if(cancelled)
+	{
+		eprintf("Decompilation cancelled\n");
+		return;
+	}
+
+	// recorded so they can be retried one by one with a larger budget
+	size_t partial_count = std::count_if(jobs.begin(), jobs.end(), [](const BatchJob &job) { return job.partial; });
+	if(partial_count)
+	{
+		eprintf("%zu functions exceeded the decompile budget (%s, %s), retry them with:\n", partial_count,
+				cfg_var_timeout.GetName(), cfg_var_maxiter.GetName());
+		for(const auto &job : jobs)
+		{
+			if(job.partial)
+				eprintf("pdg @ 0x%08" PFMT64x "\n", job.addr);
+		}
+	}
+}
+
+
 // see sleighexample.cc
 class AssemblyRaw : public AssemblyEmit
 {
@@ -333,12 +903,14 @@ class PcodeRawOut : public PcodeEmit
 
 static void Disassemble(RCore *core, ut64 ops)
 {
+	LanguageLock lock;
+
 	if(!ops)
 		ops = 10; // random default value
 
-	R2Architecture arch(core, cfg_var_sleighid.GetString(core->config));
-	DocumentStorage store;
-	arch.init(store);
+	ArchCache::Lease lease = arch_cache.checkout(core, cfg_var_sleighid.GetString(core->config), cfg_var_rawptr.GetBool(core->config),
+			FastProfile(core->config));
+	R2Architecture &arch = *lease;
 
 	const Translate *trans = arch.translate;
 	PcodeRawOut emit;
@@ -354,9 +926,8 @@ static void Disassemble(RCore *core, ut64 ops)
 
 static void ListSleighLangs()
 {
-	DecompilerLock lock;
+	LanguageLock lock;
 
-	SleighArchitecture::collectSpecFiles(std::cerr);
 	auto langs = SleighArchitecture::getLanguageDescriptions();
 	if(langs.empty())
 	{
@@ -372,9 +943,41 @@ static void ListSleighLangs()
 	});
 }
 
+static void DecodeSerialized(const char *input)
+{
+	DecompileMode mode = DecompileMode::DEFAULT;
+	switch(*input)
+	{
+		case 'o':
+			mode = DecompileMode::OFFSET;
+			input++;
+			break;
+		case '*':
+			mode = DecompileMode::STATEMENTS;
+			input++;
+			break;
+		case 'j':
+			mode = DecompileMode::JSON;
+			input++;
+			break;
+		default:
+			break;
+	}
+	while(*input == ' ')
+		input++;
+	RAnnotatedCode *code = r_annotated_code_deserialize_base64(input);
+	if(!code)
+	{
+		eprintf("Invalid " CMD_PREFIX "b dump\n");
+		return;
+	}
+	PrintAnnotatedCode(code, mode);
+	r_annotated_code_free(code);
+}
+
 static void PrintAutoSleighLang(RCore *core)
 {
-	DecompilerLock lock;
+	LanguageLock lock;
 	try
 	{
 		auto id = SleighIdFromCore(core);
@@ -402,9 +1005,29 @@ static void _cmd(RCore *core, const char *input)
 		case 'j': // "pdgj"
 			Decompile(core, DecompileMode::JSON);
 			break;
+		case 'b': // "pdgb"
+			if(input[1] == 'd') // "pdgbd"
+				DecodeSerialized(input + 2);
+			else
+				Decompile(core, DecompileMode::BINARY);
+			break;
 		case 'o': // "pdgo"
 			Decompile(core, DecompileMode::OFFSET);
 			break;
+		case 'T': // "pdgT"
+			Decompile(core, input[1] == 'j' ? DecompileMode::PROFILE_JSON : DecompileMode::PROFILE);
+			break;
+		case 'a': // "pdga"
+			if(input[1] == 'j') // "pdgaj"
+			{
+				const char *path = input + 2;
+				while(*path == ' ')
+					path++;
+				DecompileAll(core, true, path);
+			}
+			else
+				DecompileAll(core, false, std::string());
+			break;
 		case '*': // "pdg*"
 			Decompile(core, DecompileMode::STATEMENTS);
 			break;
@@ -441,12 +1064,23 @@ static int r2ghidra_cmd(void *user, const char *input)
 
 bool SleighHomeConfig(void */* user */, void *data)
 {
-	std::lock_guard<std::recursive_mutex> lock(decompiler_mutex);
+	LanguageLock lock(true);
 	auto node = reinterpret_cast<RConfigNode *>(data);
+	memory_cache.clear();
+	arch_cache.clear();
+	SpecCache::clear();
 	SleighArchitecture::shutdown();
 	SleighArchitecture::specpaths = FileManage();
 	if(node->value && *node->value)
 		SleighArchitecture::scanForSleighDirectories(node->value);
+	languages_loaded = false;
+	return true;
+}
+
+bool CacheDirConfig(void */* user */, void *data)
+{
+	auto node = reinterpret_cast<RConfigNode *>(data);
+	SpecCache::setDir(node->value ? node->value : "");
 	return true;
 }
 
@@ -483,8 +1117,10 @@ static void SetInitialSleighHome(RConfig *cfg)
 
 static int r2ghidra_init(void *user, const char *cmd)
 {
-	std::lock_guard<std::recursive_mutex> lock(decompiler_mutex);
-	startDecompilerLibrary(nullptr);
+	{
+		LanguageLock lock(true);
+		startDecompilerLibrary(nullptr);
+	}
 
 	auto *rcmd = reinterpret_cast<RCmd *>(user);
 	auto *core = reinterpret_cast<RCore *>(rcmd->data);
@@ -502,12 +1138,22 @@ static int r2ghidra_init(void *user, const char *cmd)
 	r_config_lock (cfg, true);
 
 	SetInitialSleighHome(cfg);
+	memory_cache.hook(core);
+	R2TypeFactory::hookSdbTypes(core);
 	return true;
 }
 
 static int r2ghidra_fini(void *user, const char *cmd)
 {
-	std::lock_guard<std::recursive_mutex> lock(decompiler_mutex);
+	auto *rcmd = reinterpret_cast<RCmd *>(user);
+	auto *core = reinterpret_cast<RCore *>(rcmd->data);
+	R2TypeFactory::unhookSdbTypes(core);
+
+	LanguageLock lock(true);
+	memory_cache.unhook();
+	memory_cache.clear();
+	arch_cache.clear();
+	SpecCache::clear();
 	shutdownDecompilerLibrary();
 	return true;
 }